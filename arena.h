@@ -0,0 +1,115 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "utility/common.h"
+
+// Linear allocator: memory is bumped from large blocks and released all at once by reset.
+// Blocks are kept by reset, so repeated loads of similar size don't touch general heap. Not thread-safe.
+//
+class Arena : public utility::NonCopyable, public utility::NonMovable {
+public:
+    static constexpr std::size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+    Arena(std::size_t blockSize = DEFAULT_BLOCK_SIZE) : _blockSize(blockSize) {}
+
+    // @alignment must be a power of two not greater than alignof(std::max_align_t)
+    //
+    void *allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) {
+        for (; _current < _blocks.size(); _current++, _offset = 0) {
+            std::size_t start = (_offset + alignment - 1) & ~(alignment - 1);
+
+            if (start + size <= _blocks[_current].size) {
+                _offset = start + size;
+                return _blocks[_current].data.get() + start;
+            }
+        }
+
+        // allocation larger than block size gets its own block
+        std::size_t blockSize = std::max(size, _blockSize);
+        _blocks.emplace_back(Block {std::unique_ptr<std::uint8_t []>(new std::uint8_t [blockSize]), blockSize});
+        _offset = size;
+        return _blocks.back().data.get();
+    }
+
+    // Invalidates everything allocated, blocks are reused by next allocations
+    //
+    void reset() {
+        _current = 0;
+        _offset = 0;
+    }
+
+    // Frees blocks beyond the first @keepBytes, so single huge use doesn't keep its peak reserved. Invalidates like reset.
+    //
+    void trim(std::size_t keepBytes) {
+        std::size_t keptBytes = 0;
+        std::size_t keptCount = 0;
+
+        while (keptCount < _blocks.size() && keptBytes + _blocks[keptCount].size <= keepBytes) {
+            keptBytes += _blocks[keptCount++].size;
+        }
+
+        _blocks.erase(_blocks.begin() + keptCount, _blocks.end());
+        reset();
+    }
+
+    std::size_t getReservedBytes() const {
+        std::size_t result = 0;
+
+        for (const auto &block : _blocks) {
+            result += block.size;
+        }
+
+        return result;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<std::uint8_t []> data;
+        std::size_t size;
+    };
+
+    std::size_t _blockSize;
+    std::vector<Block> _blocks;
+    std::size_t _current = 0;
+    std::size_t _offset = 0;
+};
+
+// Lets standard containers take memory from arena. Deallocation does nothing, memory is returned by Arena::reset,
+// so containers should be reserved up front: every growth leaves the previous buffer in arena.
+//
+template<typename T> class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator(Arena &arena) : _arena(&arena) {}
+    template<typename U> ArenaAllocator(const ArenaAllocator<U> &other) : _arena(other.getArena()) {}
+
+    T *allocate(std::size_t count) {
+        return static_cast<T *>(_arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, std::size_t) {}
+
+    Arena *getArena() const {
+        return _arena;
+    }
+
+    template<typename U> bool operator ==(const ArenaAllocator<U> &other) const {
+        return _arena == other.getArena();
+    }
+
+    template<typename U> bool operator !=(const ArenaAllocator<U> &other) const {
+        return _arena != other.getArena();
+    }
+
+private:
+    Arena *_arena;
+};
+
+template<typename T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -56,12 +56,37 @@ public:
         return _viewMatrix * _projMatrix;// math::transform3f::identity().scaled({0.5, 0.5, 0.5});// ;
     }
     
+    // Point on the far plane under @screenCoord (native screen pixels, y goes down).
+    // Ray from camera position through this point is the picking ray.
+    //
     math::vector3f screenToWorld(const math::vector2f &screenCoord) const {
-        return {};
+        float ndc[4] = {
+            2.0f * screenCoord.x / _platform->getNativeScreenWidth() - 1.0f,
+            1.0f - 2.0f * screenCoord.y / _platform->getNativeScreenHeight(),
+            1.0f,
+            1.0f
+        };
+        
+        float inverse[16], world[4];
+        
+        if (_invert(getVPMatrix().flat16, inverse) == false) {
+            return _position + _forward * _zFar;
+        }
+        
+        _transform(ndc, inverse, world);
+        return math::vector3f(world[0], world[1], world[2]) * (1.0f / world[3]);
     }
     
+    // Native screen pixels (y goes down). Points behind camera give meaningless result.
+    //
     math::vector2f worldToScreen(const math::vector3f &pointInWorld) const {
-        return {};
+        float point[4] = {pointInWorld.x, pointInWorld.y, pointInWorld.z, 1.0f}, clip[4];
+        
+        _transform(point, getVPMatrix().flat16, clip);
+        return {
+            (clip[0] / clip[3] * 0.5f + 0.5f) * _platform->getNativeScreenWidth(),
+            (0.5f - clip[1] / clip[3] * 0.5f) * _platform->getNativeScreenHeight()
+        };
     }
     
 protected:
@@ -80,6 +105,60 @@ protected:
     float _zNear = 0.1f;
     float _zFar = 100.0f;
     
+    // Row vector by row-major matrix
+    //
+    static void _transform(const float (&v)[4], const float (&m)[16], float (&result)[4]) {
+        for (int i = 0; i < 4; i++) {
+            result[i] = v[0] * m[i] + v[1] * m[4 + i] + v[2] * m[8 + i] + v[3] * m[12 + i];
+        }
+    }
+    
+    // Gauss-Jordan elimination with partial pivoting, false if matrix is singular
+    //
+    static bool _invert(const float (&m)[16], float (&result)[16]) {
+        float a[16];
+        
+        for (int i = 0; i < 16; i++) {
+            a[i] = m[i];
+            result[i] = i % 5 == 0 ? 1.0f : 0.0f;
+        }
+        for (int c = 0; c < 4; c++) {
+            int pivot = c;
+            
+            for (int r = c + 1; r < 4; r++) {
+                if (std::abs(a[r * 4 + c]) > std::abs(a[pivot * 4 + c])) {
+                    pivot = r;
+                }
+            }
+            if (std::abs(a[pivot * 4 + c]) < 1e-12f) {
+                return false;
+            }
+            for (int k = 0; k < 4; k++) {
+                std::swap(a[c * 4 + k], a[pivot * 4 + k]);
+                std::swap(result[c * 4 + k], result[pivot * 4 + k]);
+            }
+            
+            float scale = 1.0f / a[c * 4 + c];
+            
+            for (int k = 0; k < 4; k++) {
+                a[c * 4 + k] *= scale;
+                result[c * 4 + k] *= scale;
+            }
+            for (int r = 0; r < 4; r++) {
+                if (r != c) {
+                    float factor = a[r * 4 + c];
+                    
+                    for (int k = 0; k < 4; k++) {
+                        a[r * 4 + k] -= factor * a[c * 4 + k];
+                        result[r * 4 + k] -= factor * result[c * 4 + k];
+                    }
+                }
+            }
+        }
+        
+        return true;
+    }
+    
     void _updateMatrix() {
         float aspect = _platform->getNativeScreenWidth() / _platform->getNativeScreenHeight();
         
@@ -88,3 +167,34 @@ protected:
     }
 };
 
+// Planes are extracted from view-projection matrix (clip = p * VP), normals point inside
+//
+class Frustum {
+public:
+    void set(const math::transform3f &vp) {
+        const float *m = vp.flat16;
+        
+        for (int i = 0; i < 3; i++) {
+            for (int k = 0; k < 4; k++) {
+                _planes[i * 2 + 0][k] = m[k * 4 + 3] + m[k * 4 + i];
+                _planes[i * 2 + 1][k] = m[k * 4 + 3] - m[k * 4 + i];
+            }
+        }
+    }
+    
+    bool isBoxVisible(const math::vector3f &center, const math::vector3f &extent) const {
+        for (const float *plane : _planes) {
+            float distance = plane[0] * center.x + plane[1] * center.y + plane[2] * center.z + plane[3];
+            float radius = extent.x * std::abs(plane[0]) + extent.y * std::abs(plane[1]) + extent.z * std::abs(plane[2]);
+            
+            if (distance + radius < 0.0f) {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+private:
+    float _planes[6][4];
+};
@@ -0,0 +1,152 @@
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "utility/common.h"
+
+// Reports changes of watched files. On Linux folders of files are watched by inotify, so files replaced by rename
+// (usual way of saving for editors) and files created after watch are reported as well.
+// Elsewhere (or if inotify is unavailable) modification times are compared at most every POLL_INTERVAL.
+// Not thread-safe, poll never blocks.
+//
+class FileWatcher : public utility::NonCopyable, public utility::NonMovable {
+public:
+    static constexpr std::chrono::milliseconds POLL_INTERVAL = std::chrono::milliseconds(250);
+
+    FileWatcher() {
+#ifdef __linux__
+        _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    }
+
+    ~FileWatcher() {
+#ifdef __linux__
+        if (_inotify >= 0) {
+            close(_inotify);
+        }
+#endif
+    }
+
+    // File may not exist yet, its appearance is reported as change
+    //
+    void watch(const std::string &fullPath) {
+        if (_files.emplace(fullPath, _getModificationTime(fullPath)).second) {
+#ifdef __linux__
+            std::string folder = fullPath.substr(0, fullPath.rfind('/') + 1);
+
+            if (_inotify >= 0) {
+                // the same folder gives the same descriptor
+                int descriptor = inotify_add_watch(_inotify, folder.empty() ? "." : folder.data(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+                if (descriptor >= 0) {
+                    _folders[descriptor] = folder;
+                }
+            }
+#endif
+        }
+    }
+
+    // Calls @changed once for every watched file changed since previous poll
+    //
+    void poll(const std::function<void(const std::string &fullPath)> &changed) {
+        _changed.clear();
+
+        if (_inotify >= 0) {
+            _readEvents();
+        }
+        else {
+            _compareTimes();
+        }
+        for (const std::string &path : _changed) {
+            changed(path);
+        }
+    }
+
+private:
+    int _inotify = -1;
+    std::unordered_map<int, std::string> _folders; // watch descriptor -> folder path with trailing slash
+    std::unordered_map<std::string, std::int64_t> _files; // path -> modification time in ns, -1 if file is missing
+    std::vector<std::string> _changed;
+    std::chrono::steady_clock::time_point _lastComparison;
+
+    void _addChanged(const std::string &path) {
+        if (std::find(_changed.begin(), _changed.end(), path) == _changed.end()) {
+            _changed.emplace_back(path);
+        }
+    }
+
+    void _readEvents() {
+#ifdef __linux__
+        alignas(inotify_event) char buffer[4096];
+        ssize_t size;
+
+        while ((size = read(_inotify, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t offset = 0; offset < size; ) {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    for (auto &file : _files) {
+                        _addChanged(file.first);
+                    }
+                }
+                else if (event->len) {
+                    auto folder = _folders.find(event->wd);
+
+                    if (folder != _folders.end()) {
+                        std::string path = folder->second + event->name;
+
+                        if (_files.count(path)) {
+                            _addChanged(path);
+                        }
+                    }
+                }
+            }
+        }
+#endif
+    }
+
+    void _compareTimes() {
+        auto now = std::chrono::steady_clock::now();
+
+        if (now - _lastComparison >= POLL_INTERVAL) {
+            _lastComparison = now;
+
+            for (auto &file : _files) {
+                std::int64_t time = _getModificationTime(file.first);
+
+                if (time != file.second) {
+                    file.second = time;
+                    _addChanged(file.first);
+                }
+            }
+        }
+    }
+
+    static std::int64_t _getModificationTime(const std::string &path) {
+        struct stat info;
+
+        if (stat(path.data(), &info) != 0) {
+            return -1;
+        }
+#ifdef __APPLE__
+        return std::int64_t(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+        return std::int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    }
+};
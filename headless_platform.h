@@ -0,0 +1,358 @@
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <cstdarg>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "utility/common.h"
+#include "platform/interfaces.h"
+
+// Platform without screen and input for tests and benchmarks. Files are read relative to working directory,
+// run calls frame callback given number of times with fixed time step. Messages and errors may come from any thread.
+//
+class HeadlessPlatform : public platform::Platform, public utility::NonCopyable, public utility::NonMovable {
+public:
+    HeadlessPlatform(float screenWidth = 1280.0f, float screenHeight = 720.0f) : _screenWidth(screenWidth), _screenHeight(screenHeight) {}
+
+    void setRunFrames(std::size_t frameCount, float dtSec) {
+        _runFrames = frameCount;
+        _runStep = dtSec;
+    }
+
+    // Muted messages are dropped, errors are still printed and counted
+    //
+    void setMessagesMuted(bool muted) {
+        _messagesMuted = muted;
+    }
+
+    std::size_t getErrorCount() const {
+        return _errorCount;
+    }
+
+    // Calls handlers added by addTouchEventHandlers as if touch @touchID started, moved and finished at the same point
+    //
+    void touch(float x, float y, std::size_t touchID = 1) {
+        platform::TouchEventArgs args {x, y, touchID};
+
+        for (auto &handlers : _touchHandlers) {
+            if (handlers) {
+                handlers->start(args);
+                handlers->move(args);
+                handlers->finish(args);
+            }
+        }
+    }
+
+    float getNativeScreenWidth() const override {
+        return _screenWidth;
+    }
+
+    float getNativeScreenHeight() const override {
+        return _screenHeight;
+    }
+
+    bool loadFile(const char *path, std::unique_ptr<std::uint8_t[]> &data, std::size_t &size) override {
+        bool result = false;
+
+        if (FILE *file = fopen(path, "rb")) {
+            if (fseek(file, 0, SEEK_END) == 0) {
+                long length = ftell(file);
+
+                if (length >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+                    size = std::size_t(length);
+                    data = std::make_unique<std::uint8_t[]>(size);
+                    result = fread(data.get(), 1, size, file) == size;
+                }
+            }
+
+            fclose(file);
+        }
+
+        return result;
+    }
+
+    platform::EventHandlersToken addTouchEventHandlers(
+        std::function<void(const platform::TouchEventArgs &)> &&start,
+        std::function<void(const platform::TouchEventArgs &)> &&move,
+        std::function<void(const platform::TouchEventArgs &)> &&finish
+    ) override {
+        _touchHandlers.emplace_back(std::make_unique<TouchHandlers>(TouchHandlers {std::move(start), std::move(move), std::move(finish)}));
+        return _touchHandlers.back().get();
+    }
+
+    void removeEventHandlers(platform::EventHandlersToken token) override {
+        for (auto &handlers : _touchHandlers) {
+            if (handlers.get() == token) {
+                handlers = nullptr;
+            }
+        }
+    }
+
+    void run(std::function<void(float)> &&updateAndDraw) override {
+        for (std::size_t i = 0; i < _runFrames; i++) {
+            updateAndDraw(_runStep);
+        }
+    }
+
+    void logMsg(const char *fmt, ...) override {
+        if (_messagesMuted == false) {
+            va_list args;
+            va_start(args, fmt);
+            _print(stdout, fmt, args);
+            va_end(args);
+        }
+    }
+
+    void logError(const char *fmt, ...) override {
+        va_list args;
+        va_start(args, fmt);
+        _print(stderr, fmt, args);
+        va_end(args);
+        _errorCount++;
+    }
+
+private:
+    struct TouchHandlers {
+        std::function<void(const platform::TouchEventArgs &)> start;
+        std::function<void(const platform::TouchEventArgs &)> move;
+        std::function<void(const platform::TouchEventArgs &)> finish;
+    };
+
+    float _screenWidth;
+    float _screenHeight;
+    std::size_t _runFrames = 1;
+    float _runStep = 1.0f / 60.0f;
+    std::atomic<bool> _messagesMuted {false};
+    std::atomic<std::size_t> _errorCount {0};
+    std::vector<std::unique_ptr<TouchHandlers>> _touchHandlers;
+    std::mutex _printMutex;
+
+    void _print(FILE *stream, const char *fmt, va_list args) {
+        std::lock_guard<std::mutex> guard (_printMutex);
+        vfprintf(stream, fmt, args);
+        fputc('\n', stream);
+    }
+};
+
+// Rendering device which draws nothing. Records calls, bytes of created buffers and textures, drawn vertices and instances.
+// Resources may be created from any thread, other calls are expected from rendering thread.
+// Contents of created buffers are kept only with setKeepData, so recording doesn't distort timings.
+//
+class HeadlessRenderingDevice : public platform::RenderingDevice, public utility::NonCopyable, public utility::NonMovable {
+public:
+    struct Counters {
+        std::size_t shadersCreated = 0;
+        std::size_t dataCreated = 0;
+        std::size_t dataBytes = 0;
+        std::size_t texturesCreated = 0;
+        std::size_t textureBytes = 0;
+        std::size_t shadersApplied = 0;
+        std::size_t texturesApplied = 0;
+        std::size_t drawCalls = 0;
+        std::size_t instancedDrawCalls = 0;
+        std::size_t vertices = 0;  // instanced draws count vertexCount * instanceCount
+        std::size_t instances = 0;
+        std::size_t frames = 0;
+    };
+
+    class Data : public platform::StructuredData {
+    public:
+        Data(const void *data, std::uint32_t count, std::uint32_t stride, bool keep) : _count(count), _stride(stride) {
+            if (keep && data) {
+                _bytes.assign(static_cast<const std::uint8_t *>(data), static_cast<const std::uint8_t *>(data) + std::size_t(count) * stride);
+            }
+        }
+
+        std::uint32_t getCount() const override {
+            return _count;
+        }
+
+        std::uint32_t getStride() const override {
+            return _stride;
+        }
+
+        // Empty unless device keeps data
+        //
+        const std::vector<std::uint8_t> &getBytes() const {
+            return _bytes;
+        }
+
+    private:
+        std::uint32_t _count;
+        std::uint32_t _stride;
+        std::vector<std::uint8_t> _bytes;
+    };
+
+    class Texture : public platform::Texture2D {
+    public:
+        Texture(std::uint32_t width, std::uint32_t height) : _width(width), _height(height) {}
+
+        std::uint32_t getWidth() const override {
+            return _width;
+        }
+
+        std::uint32_t getHeight() const override {
+            return _height;
+        }
+
+    private:
+        std::uint32_t _width;
+        std::uint32_t _height;
+    };
+
+    class Shader : public platform::Shader {
+    public:
+        Shader(const char *source) : _source(source) {}
+
+        const std::string &getSource() const {
+            return _source;
+        }
+
+    private:
+        std::string _source;
+    };
+
+    // Instanced draw with instance buffer and constants of the last applied shader
+    //
+    struct Draw {
+        const Shader *shader;
+        const void *constants;
+        std::shared_ptr<platform::StructuredData> vertexData;
+        std::shared_ptr<platform::StructuredData> instanceData;
+        std::uint32_t vertexCount;
+        std::uint32_t instanceCount;
+    };
+
+    void setKeepData(bool keep) {
+        _keepData = keep;
+    }
+
+    // Since the last prepareFrame
+    //
+    Counters getFrameCounters() const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        return _frame;
+    }
+
+    // Since creation of device
+    //
+    Counters getTotalCounters() const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        Counters result = _total;
+        _add(result, _frame);
+        return result;
+    }
+
+    // Instanced draws since the last prepareFrame, recorded only with setKeepData.
+    // Constants pointer is valid only while owner of constants keeps them.
+    //
+    const std::vector<Draw> &getFrameDraws() const {
+        return _draws;
+    }
+
+    std::shared_ptr<platform::Shader> createShader(
+        const char *shadersrc,
+        const std::initializer_list<platform::ShaderInput> &,
+        const std::initializer_list<platform::ShaderInput> &,
+        const void *
+    ) override {
+        std::lock_guard<std::mutex> guard (_mutex);
+        _frame.shadersCreated++;
+        return std::make_shared<Shader>(shadersrc);
+    }
+
+    std::shared_ptr<platform::Texture2D> createTexture(platform::Texture2D::Format, std::uint32_t width, std::uint32_t height, const std::initializer_list<const void *> &mipsData) override {
+        std::lock_guard<std::mutex> guard (_mutex);
+        std::size_t bytes = 0;
+
+        for (std::size_t i = 0; i < mipsData.size(); i++) {
+            bytes += std::size_t(std::max(width >> i, 1u)) * std::max(height >> i, 1u) * 4;
+        }
+
+        _frame.texturesCreated++;
+        _frame.textureBytes += bytes;
+        return std::make_shared<Texture>(width, height);
+    }
+
+    std::shared_ptr<platform::StructuredData> createData(const void *data, std::uint32_t count, std::uint32_t stride) override {
+        std::lock_guard<std::mutex> guard (_mutex);
+        _frame.dataCreated++;
+        _frame.dataBytes += std::size_t(count) * stride;
+        return std::make_shared<Data>(data, count, stride, _keepData);
+    }
+
+    void updateCameraTransform(const float (&)[3], const float (&)[3], const float (&)[16]) override {}
+
+    void applyShader(const std::shared_ptr<platform::Shader> &shader, const void *constants) override {
+        _shader = static_cast<const Shader *>(shader.get());
+        _constants = constants;
+        _frame.shadersApplied++;
+    }
+
+    void applyTextures(const std::initializer_list<const platform::Texture2D *> &textures) override {
+        _frame.texturesApplied += textures.size();
+    }
+
+    void drawGeometry(std::uint32_t vertexCount, platform::Topology) override {
+        _frame.drawCalls++;
+        _frame.vertices += vertexCount;
+    }
+
+    void drawGeometry(
+        const std::shared_ptr<platform::StructuredData> &vertexData,
+        const std::shared_ptr<platform::StructuredData> &instanceData,
+        std::uint32_t vertexCount,
+        std::uint32_t instanceCount,
+        platform::Topology
+    ) override {
+        _frame.drawCalls++;
+        _frame.instancedDrawCalls++;
+        _frame.vertices += std::size_t(vertexCount) * instanceCount;
+        _frame.instances += instanceCount;
+
+        if (_keepData) {
+            _draws.emplace_back(Draw {_shader, _constants, vertexData, instanceData, vertexCount, instanceCount});
+        }
+    }
+
+    void prepareFrame() override {
+        std::lock_guard<std::mutex> guard (_mutex);
+        _add(_total, _frame);
+        _frame = Counters {};
+        _frame.frames = 1;
+        _draws.clear();
+    }
+
+    void presentFrame(float) override {}
+
+private:
+    mutable std::mutex _mutex;
+    Counters _frame;
+    Counters _total;
+    std::vector<Draw> _draws;
+    const Shader *_shader = nullptr;
+    const void *_constants = nullptr;
+    bool _keepData = false;
+
+    static void _add(Counters &to, const Counters &from) {
+        to.shadersCreated += from.shadersCreated;
+        to.dataCreated += from.dataCreated;
+        to.dataBytes += from.dataBytes;
+        to.texturesCreated += from.texturesCreated;
+        to.textureBytes += from.textureBytes;
+        to.shadersApplied += from.shadersApplied;
+        to.texturesApplied += from.texturesApplied;
+        to.drawCalls += from.drawCalls;
+        to.instancedDrawCalls += from.instancedDrawCalls;
+        to.vertices += from.vertices;
+        to.instances += from.instances;
+        to.frames += from.frames;
+    }
+};
@@ -22,8 +22,9 @@ int main(int argc, char * argv[]) {
     auto camera = std::make_shared<Camera>(platform);
     auto cameraController = std::make_shared<OrbitCameraController>(platform, camera);
     
-    auto voxelPalette = voxel::loadPalette(platform, renderingDevice, "data/palette.png");
-    auto voxelMeshes = voxel::makeVoxelMeshes(platform, renderingDevice, voxelPalette);
+    std::vector<std::uint8_t> voxelPalette;
+    voxel::decodePalette(platform, "data/palette.png", voxelPalette);
+    auto voxelMeshes = voxel::makeVoxelMeshes(platform, renderingDevice, camera, voxelPalette);
 
     auto voxelMesh = voxelMeshes->loadMesh("data/knight");
     
@@ -51,6 +52,7 @@ int main(int argc, char * argv[]) {
         primitives->drawAxis();
 
         voxelMeshes->updateAndDraw(dtSec);
+        primitives->flush();
 
         renderingDevice->presentFrame(dtSec);
     });
@@ -6,87 +6,66 @@
 
 // TODO: text, textured rect
 
+// Primitives are accumulated into constant batches and drawn by flush (or earlier when a batch is full):
+// one draw call per MAX_BATCH_LINES lines and per MAX_BATCH_CIRCLES circles.
+// Cubes and cylinders are made of lines and circles.
+//
 class Primitives {
 public:
+    static constexpr std::size_t MAX_BATCH_LINES = 42;
+    static constexpr std::size_t MAX_BATCH_CIRCLES = 64;
+    static constexpr std::size_t CIRCLE_SEGMENTS = 36;
+    
     Primitives(const std::shared_ptr<platform::RenderingDevice> &renderingDevice) : _renderingDevice(renderingDevice) {}
     
     inline void drawLine(const math::vector3f &p1, const math::vector3f &p2, const math::color &rgba) {
-        static const char *lineShader = R"(
-            const {
-                position[2] : float4
-                color : float4
-            }
-            vssrc {
-                out_position = _transform(position[vertex_ID], _viewProjMatrix);
-            }
-            fssrc {
-                out_color = color;
-            }
-        )";
-        
-        struct {
-            math::vector4f position1;
-            math::vector4f position2;
-            math::vector4f color;
-        }
-        lineData {
-            {p1, 1},
-            {p2, 1},
-            rgba
-        };
-        
-        if (_lineShader == nullptr) {
-            _lineShader = _renderingDevice->createShader(lineShader, {
-                {"ID", platform::ShaderInput::Format::VERTEX_ID}
-            });
+        if (_lineCount == MAX_BATCH_LINES) {
+            _flushLines();
         }
         
-        _renderingDevice->applyShader(_lineShader, &lineData);
-        _renderingDevice->drawGeometry(2, platform::Topology::LINES);
+        _lineBatch.positions[_lineCount * 2 + 0] = {p1, 1};
+        _lineBatch.positions[_lineCount * 2 + 1] = {p2, 1};
+        _lineBatch.colors[_lineCount++] = rgba;
     }
     
     inline void drawCircleXZ(const math::vector3f &position, float radius, const math::color &rgba) {
-        static const char *circleShader = R"(
-            const {
-                position_radius : float4
-                color : float4
-            }
-            vssrc {
-                float4 point = float4(position_radius.xyz, 1);
-                point.x = point.x + position_radius.w * _cos(6.2831853 * float(vertex_ID) / 36.0);
-                point.z = point.z + position_radius.w * _sin(6.2831853 * float(vertex_ID) / 36.0);
-                out_position = _transform(point, _viewProjMatrix);
-            }
-            fssrc {
-                out_color = color;
-            }
-        )";
-        
-        struct {
-            math::vector4f positionRadius;
-            math::vector4f color;
-        }
-        circleData {
-            {position, radius},
-            rgba
-        };
-        
-        if (_circleShader == nullptr) {
-            _circleShader = _renderingDevice->createShader(circleShader, {
-                {"ID", platform::ShaderInput::Format::VERTEX_ID}
-            });
+        if (_circleCount == MAX_BATCH_CIRCLES) {
+            _flushCircles();
         }
         
-        _renderingDevice->applyShader(_circleShader, &circleData);
-        _renderingDevice->drawGeometry(37, platform::Topology::LINESTRIP);
+        _circleBatch.positionRadius[_circleCount] = {position, radius};
+        _circleBatch.colors[_circleCount++] = rgba;
     }
     
+    // @position is center of the bottom circle
+    //
     inline void drawCylinderXZ(const math::vector3f &position, float radius, float height, const math::color &rgba) {
+        math::vector3f top = position + math::vector3f(0, height, 0);
         
+        drawCircleXZ(position, radius, rgba);
+        drawCircleXZ(top, radius, rgba);
+        
+        for (int i = 0; i < 4; i++) {
+            math::vector3f offset = i % 2 ? math::vector3f(0, 0, i < 2 ? radius : -radius) : math::vector3f(i < 2 ? radius : -radius, 0, 0);
+            drawLine(position + offset, top + offset, rgba);
+        }
     }
     
+    // Axis-aligned box with opposite corners @p1 and @p2
+    //
     inline void drawCube(const math::vector3f &p1, const math::vector3f &p2, const math::color &rgba) {
+        auto corner = [&](int index) {
+            return math::vector3f(index & 1 ? p2.x : p1.x, index & 2 ? p2.y : p1.y, index & 4 ? p2.z : p1.z);
+        };
         
+        // corner indices differ by a single bit along every edge
+        for (int i = 0; i < 8; i++) {
+            for (int bit = 1; bit < 8; bit <<= 1) {
+                if ((i & bit) == 0) {
+                    drawLine(corner(i), corner(i | bit), rgba);
+                }
+            }
+        }
     }
     
     inline void drawAxis() {
@@ -100,8 +79,103 @@ public:
         drawLine({0, 0, 100}, {0, 0, 0}, {0, 0, 1, 1});
     }
     
+    // Draws everything accumulated since the last flush. Call once per frame before presenting.
+    //
+    inline void flush() {
+        _flushLines();
+        _flushCircles();
+    }
+    
 protected:
     std::shared_ptr<platform::RenderingDevice> _renderingDevice;
     std::shared_ptr<platform::Shader> _lineShader;
     std::shared_ptr<platform::Shader> _circleShader;
+    
+    struct {
+        math::vector4f positions[MAX_BATCH_LINES * 2];
+        math::color colors[MAX_BATCH_LINES];
+    }
+    _lineBatch;
+    
+    struct {
+        math::vector4f positionRadius[MAX_BATCH_CIRCLES];
+        math::color colors[MAX_BATCH_CIRCLES];
+    }
+    _circleBatch;
+    
+    std::size_t _lineCount = 0;
+    std::size_t _circleCount = 0;
+    
+    inline void _flushLines() {
+        static const char *lineShader = R"(
+            const {
+                position[84] : float4
+                color[42] : float4
+            }
+            inter {
+                color : float4
+            }
+            vssrc {
+                out_position = _transform(position[vertex_ID], _viewProjMatrix);
+                inter.color = color[vertex_ID / 2];
+            }
+            fssrc {
+                out_color = inter.color;
+            }
+        )";
+        
+        static_assert(MAX_BATCH_LINES == 42, "position[84] and color[42] of lineShader must hold MAX_BATCH_LINES lines");
+        
+        if (_lineCount) {
+            if (_lineShader == nullptr) {
+                _lineShader = _renderingDevice->createShader(lineShader, {
+                    {"ID", platform::ShaderInput::Format::VERTEX_ID}
+                });
+            }
+            
+            _renderingDevice->applyShader(_lineShader, &_lineBatch);
+            _renderingDevice->drawGeometry(std::uint32_t(_lineCount * 2), platform::Topology::LINES);
+            _lineCount = 0;
+        }
+    }
+    
+    inline void _flushCircles() {
+        static const char *circleShader = R"(
+            const {
+                position_radius[64] : float4
+                color[64] : float4
+            }
+            inter {
+                color : float4
+            }
+            vssrc {
+                int circle = vertex_ID / 72;
+                int segmentPoint = (vertex_ID - circle * 72 + 1) / 2;
+                float4 point = float4(position_radius[circle].xyz, 1);
+                point.x = point.x + position_radius[circle].w * _cos(6.2831853 * float(segmentPoint) / 36.0);
+                point.z = point.z + position_radius[circle].w * _sin(6.2831853 * float(segmentPoint) / 36.0);
+                out_position = _transform(point, _viewProjMatrix);
+                inter.color = color[circle];
+            }
+            fssrc {
+                out_color = inter.color;
+            }
+        )";
+        
+        static_assert(MAX_BATCH_CIRCLES == 64, "position_radius[64] and color[64] of circleShader must hold MAX_BATCH_CIRCLES circles");
+        static_assert(CIRCLE_SEGMENTS == 36, "circleShader takes 72 vertices (2 per segment) for every circle");
+        
+        if (_circleCount) {
+            if (_circleShader == nullptr) {
+                _circleShader = _renderingDevice->createShader(circleShader, {
+                    {"ID", platform::ShaderInput::Format::VERTEX_ID}
+                });
+            }
+            
+            // every circle is CIRCLE_SEGMENTS separate segments, so circles don't connect to each other
+            _renderingDevice->applyShader(_circleShader, &_circleBatch);
+            _renderingDevice->drawGeometry(std::uint32_t(_circleCount * CIRCLE_SEGMENTS * 2), platform::Topology::LINES);
+            _circleCount = 0;
+        }
+    }
 };
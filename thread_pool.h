@@ -0,0 +1,142 @@
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include "utility/common.h"
+
+// Fixed set of worker threads executing pushed tasks in FIFO order.
+// Tasks which are not started at destruction are dropped.
+// parallelFor splits work between calling thread and workers.
+//
+class ThreadPool : public utility::NonCopyable, public utility::NonMovable {
+public:
+    ThreadPool(std::size_t threadCount = defaultThreadCount()) {
+        _threads.reserve(threadCount);
+
+        for (std::size_t i = 0; i < threadCount; i++) {
+            _threads.emplace_back([this] {
+                _workerLoop();
+            });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard (_mutex);
+            _exit = true;
+        }
+
+        _condition.notify_all();
+
+        for (auto &thread : _threads) {
+            thread.join();
+        }
+    }
+
+    static std::size_t defaultThreadCount() {
+        unsigned count = std::thread::hardware_concurrency();
+        return count > 1 ? count - 1 : 1;
+    }
+
+    void push(std::function<void()> &&task) {
+        {
+            std::lock_guard<std::mutex> guard (_mutex);
+            _tasks.emplace_back(std::move(task));
+        }
+
+        _condition.notify_one();
+    }
+
+    // Calls @task for every index in [0, count) and returns when all calls are done.
+    // Calling thread and workers take indices one by one, so uneven work is balanced and
+    // workers busy with other tasks only reduce parallelism, calling thread completes the rest itself.
+    //
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)> &task) {
+        if (count < 2 || _threads.empty()) {
+            for (std::size_t i = 0; i < count; i++) {
+                task(i);
+            }
+            
+            return;
+        }
+        
+        struct Job {
+            std::function<void(std::size_t)> task;
+            std::size_t count;
+            std::atomic<std::size_t> next {0};
+            std::size_t done = 0;
+            std::mutex mutex;
+            std::condition_variable condition;
+        };
+        
+        std::shared_ptr<Job> job = std::make_shared<Job>();
+        job->task = task;
+        job->count = count;
+        
+        // helpers which start after all indices are taken do nothing, so job outlives the call
+        auto run = [job] {
+            std::size_t completed = 0;
+            
+            for (std::size_t i = job->next++; i < job->count; i = job->next++) {
+                job->task(i);
+                completed++;
+            }
+            
+            if (completed) {
+                std::lock_guard<std::mutex> guard (job->mutex);
+                
+                if ((job->done += completed) == job->count) {
+                    job->condition.notify_all();
+                }
+            }
+        };
+        
+        for (std::size_t i = 0; i < _threads.size() && i + 1 < count; i++) {
+            push(run);
+        }
+        
+        run();
+        
+        std::unique_lock<std::mutex> lock (job->mutex);
+        job->condition.wait(lock, [&job] {
+            return job->done == job->count;
+        });
+    }
+
+protected:
+    std::vector<std::thread> _threads;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _exit = false;
+
+    void _workerLoop() {
+        while (true) {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock (_mutex);
+                _condition.wait(lock, [this] {
+                    return _exit || _tasks.size();
+                });
+
+                if (_exit) {
+                    break;
+                }
+
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+};
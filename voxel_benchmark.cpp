@@ -0,0 +1,506 @@
+// Benchmark of voxel loading and drawing on headless platform, so costs can be measured on a build machine.
+// Synthetic models of growing size are written into a temporary folder, then every case is timed over several iterations.
+// Every result is one line "<case>/<parameter> iterations=<n> ms=<median> [<counter>=<value> ...]": counters are
+// deterministic and timings are medians, so outputs of two runs can be diffed or parsed for regression tracking.
+//
+// Usage: voxel_benchmark [folder for synthetic models] [filter: only cases starting with it]
+// Build from repository root with platform and utility headers on include path, for example:
+//   g++ -std=c++17 -O2 -I<include path> voxel_benchmark.cpp voxel_meshes.cpp voxel_world.cpp voxel_utility.cpp voxel_kernels.cpp voxel_bricks.cpp voxel_palettes.cpp -lpthread
+//
+#include "headless_platform.h"
+#include "voxel_meshes.h"
+#include "voxel_utility.h"
+#include "voxel_kernels.h"
+#include "voxel_world.h"
+#include "arena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const int MODEL_SIZES[] = {8, 16, 32, 64, 128};
+    const std::size_t MESH_COUNTS[] = {1, 100, 1000, 10000};
+    const int MODEL_FRAMES = 4;
+    const int DRAWN_MODEL_SIZE = 16;
+    const std::size_t DRAW_WARMUP_FRAMES = 5;
+    const std::size_t DRAW_FRAMES = 50;
+
+    // Meshes of LOD cases recede from camera to LOD_FAR_DISTANCE, beyond the last default LOD distance
+    const std::size_t LOD_MESH_COUNTS[] = {100, 1000};
+    const int LOD_MODEL_SIZE = 32;
+    const float LOD_NEAR_DISTANCE = 20.0f;
+    const float LOD_FAR_DISTANCE = 800.0f;
+
+    // Static props of render mode cases, large enough for faces to pay off
+    const std::size_t PROP_MESH_COUNTS[] = {1, 10, 100};
+    const int PROP_MODEL_SIZE = 64;
+
+    // Random XYZI records of kernel cases, scalar kernels are timed against the ones selected for this CPU
+    const std::size_t KERNEL_RECORD_COUNTS[] = {65536, 1048576};
+    const std::size_t KERNEL_ITERATIONS = 20;
+
+    // Terrain of world cases is WORLD_SIDE cells wide and up to WORLD_HEIGHT high, edited by boxes of WORLD_EDIT_SIZES
+    const std::int32_t WORLD_SIDE = 256;
+    const std::int32_t WORLD_HEIGHT = 32;
+    const std::int32_t WORLD_EDIT_SIZES[] = {4, 16, 64};
+    const std::size_t WORLD_EDITS = 20;
+
+    struct Counter {
+        const char *name;
+        std::size_t value;
+    };
+
+    class Benchmark {
+    public:
+        Benchmark(const char *filter) : _filter(filter) {}
+
+        bool isEnabled(const char *name) const {
+            return std::strncmp(name, _filter, std::strlen(_filter)) == 0;
+        }
+
+        void begin() {
+            _start = std::chrono::steady_clock::now();
+        }
+
+        void end() {
+            _times.emplace_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count());
+        }
+
+        // Prints median of iterations recorded by begin/end and clears them
+        //
+        void report(const char *name, std::size_t parameter, const std::vector<Counter> &counters) {
+            std::sort(_times.begin(), _times.end());
+            double median = _times.size() ? _times[_times.size() / 2] : 0.0;
+
+            printf("%s/%zu iterations=%zu ms=%.4f", name, parameter, _times.size(), median);
+
+            for (const Counter &counter : counters) {
+                printf(" %s=%zu", counter.name, counter.value);
+            }
+
+            printf("\n");
+            fflush(stdout);
+            _times.clear();
+        }
+
+    private:
+        const char *_filter;
+        std::chrono::steady_clock::time_point _start;
+        std::vector<double> _times;
+    };
+
+    void writeUint32(std::vector<std::uint8_t> &out, std::uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out.emplace_back(std::uint8_t(value >> (8 * i)));
+        }
+    }
+
+    void writeChunk(std::vector<std::uint8_t> &out, const char *id, const std::vector<std::uint8_t> &content, std::uint32_t childrenSize = 0) {
+        out.insert(out.end(), id, id + 4);
+        writeUint32(out, std::uint32_t(content.size()));
+        writeUint32(out, childrenSize);
+        out.insert(out.end(), content.begin(), content.end());
+    }
+
+    // Sphere of @size voxels in diameter, colors go in horizontal bands with scattered spots.
+    // Odd frames are shifted by one voxel, so every frame differs from the previous one. Returns voxel count of frame 0.
+    //
+    std::size_t writeSyntheticModel(const std::filesystem::path &folder, int size, int frameCount) {
+        std::vector<std::uint8_t> children;
+        std::size_t result = 0;
+
+        writeChunk(children, "PACK", {std::uint8_t(frameCount), 0, 0, 0});
+
+        for (int frame = 0; frame < frameCount; frame++) {
+            std::vector<std::uint8_t> dimensions, voxels;
+            std::uint32_t voxelCount = 0;
+            float radius = float(size) * 0.5f;
+            int shift = frame % 2;
+
+            writeUint32(dimensions, std::uint32_t(size + 1));
+            writeUint32(dimensions, std::uint32_t(size));
+            writeUint32(dimensions, std::uint32_t(size));
+            writeUint32(voxels, 0);
+
+            for (int z = 0; z < size; z++) {
+                for (int y = 0; y < size; y++) {
+                    for (int x = 0; x < size; x++) {
+                        float dx = float(x) + 0.5f - radius, dy = float(y) + 0.5f - radius, dz = float(z) + 0.5f - radius;
+
+                        if (dx * dx + dy * dy + dz * dz <= radius * radius) {
+                            std::uint32_t hash = std::uint32_t(x * 73856093) ^ std::uint32_t(y * 19349663) ^ std::uint32_t(z * 83492791);
+                            std::uint8_t color = std::uint8_t(1 + (z / 4) % 6 + (hash % 7 == 0 ? 8 : 0));
+                            voxels.insert(voxels.end(), {std::uint8_t(x + shift), std::uint8_t(y), std::uint8_t(z), color});
+                            voxelCount++;
+                        }
+                    }
+                }
+            }
+
+            std::memcpy(voxels.data(), &voxelCount, 4);
+            writeChunk(children, "SIZE", dimensions);
+            writeChunk(children, "XYZI", voxels);
+            result = frame == 0 ? voxelCount : result;
+        }
+
+        std::vector<std::uint8_t> file = {'V', 'O', 'X', ' '};
+        writeUint32(file, 150);
+        writeChunk(file, "MAIN", {}, std::uint32_t(children.size()));
+        file.insert(file.end(), children.begin(), children.end());
+
+        std::filesystem::create_directories(folder);
+        std::ofstream(folder / "model.vox", std::ios::binary).write(reinterpret_cast<const char *>(file.data()), std::streamsize(file.size()));
+        std::ofstream(folder / "model.info") << "animation = \"loop\" 0 " << frameCount - 1 << " 10.0\n";
+        return result;
+    }
+
+    std::size_t iterationsFor(int size) {
+        return size <= 16 ? 50 : size <= 32 ? 20 : size <= 64 ? 5 : 3;
+    }
+
+    std::string modelFolder(const std::filesystem::path &root, int size) {
+        return (root / ("sphere" + std::to_string(size))).string();
+    }
+
+    // Surface drawn by instanced draws of the last frame in squared voxel units, estimate of fill cost without rasterization.
+    // Half-cube of voxel box covers three of its sides, face covers its rectangle. Device must keep data of drawn buffers.
+    //
+    std::size_t getFillArea(const HeadlessRenderingDevice &renderingDevice, voxel::VoxelMesh::RenderMode mode) {
+        std::size_t result = 0;
+
+        for (const HeadlessRenderingDevice::Draw &draw : renderingDevice.getFrameDraws()) {
+            const std::vector<std::uint8_t> &bytes = static_cast<const HeadlessRenderingDevice::Data &>(*draw.instanceData).getBytes();
+
+            for (std::size_t i = 0; i < draw.instanceCount && (i + 1) * 12 <= bytes.size(); i++) {
+                if (mode == voxel::VoxelMesh::RenderMode::FACES) {
+                    const voxel::Face &face = reinterpret_cast<const voxel::Face *>(bytes.data())[i];
+                    result += std::size_t(face.sizeU) * face.sizeV;
+                }
+                else {
+                    const voxel::Voxel &voxel = reinterpret_cast<const voxel::Voxel *>(bytes.data())[i];
+                    result += std::size_t(voxel.scaleX) * voxel.scaleY + std::size_t(voxel.scaleY) * voxel.scaleZ + std::size_t(voxel.scaleX) * voxel.scaleZ;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    void benchmarkKernel(Benchmark &benchmark, const std::string &name, std::size_t count, const std::function<void()> &kernel) {
+        for (std::size_t k = 0; k < KERNEL_ITERATIONS; k++) {
+            benchmark.begin();
+            kernel();
+            benchmark.end();
+        }
+
+        benchmark.report(name.data(), count, {});
+    }
+
+    // Times updateAndDraw after warming up and reports counters of the last frame
+    //
+    void benchmarkDraw(Benchmark &benchmark, const char *name, std::size_t parameter, HeadlessRenderingDevice &renderingDevice, voxel::VoxelMeshes &meshes, std::vector<Counter> &&counters = {}) {
+        for (std::size_t frame = 0; frame < DRAW_WARMUP_FRAMES + DRAW_FRAMES; frame++) {
+            renderingDevice.prepareFrame();
+
+            if (frame >= DRAW_WARMUP_FRAMES) {
+                benchmark.begin();
+                meshes.updateAndDraw(1.0f / 60.0f);
+                benchmark.end();
+            }
+            else {
+                meshes.updateAndDraw(1.0f / 60.0f);
+            }
+        }
+
+        HeadlessRenderingDevice::Counters frameCounters = renderingDevice.getFrameCounters();
+        voxel::VoxelMeshes::Statistics statistics = meshes.getStatistics();
+
+        counters.insert(counters.begin(), {
+            {"drawn", statistics.meshesDrawn},
+            {"drawCalls", frameCounters.drawCalls},
+            {"instances", frameCounters.instances},
+            {"vertices", frameCounters.vertices}
+        });
+
+        benchmark.report(name, parameter, counters);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::filesystem::path root = argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::temp_directory_path() / "voxel_benchmark";
+    Benchmark benchmark (argc > 2 ? argv[2] : "");
+
+    std::shared_ptr<HeadlessPlatform> platform = std::make_shared<HeadlessPlatform>();
+    std::shared_ptr<HeadlessRenderingDevice> renderingDevice = std::make_shared<HeadlessRenderingDevice>();
+    std::shared_ptr<Camera> camera = std::make_shared<Camera>(platform);
+    std::vector<std::size_t> voxelCounts;
+
+    platform->setMessagesMuted(true);
+    camera->setPerspectiveProj(50.0f, 0.1f, 5000.0f);
+    camera->setLookAtByRight(math::vector3f(0, 0, 0), math::vector3f(0, 0, -1), math::vector3f(1, 0, 0));
+
+    for (int size : MODEL_SIZES) {
+        voxelCounts.emplace_back(writeSyntheticModel(modelFolder(root, size), size, MODEL_FRAMES));
+    }
+
+    if (benchmark.isEnabled("loadModel")) {
+        for (std::size_t i = 0; i < std::size(MODEL_SIZES); i++) {
+            std::string path = modelFolder(root, MODEL_SIZES[i]) + "/model.vox";
+            voxel::ModelOptions options = voxel::makeModelOptions(voxel::ModelInfo {});
+            Arena arena;
+            std::size_t boxes = 0;
+
+            for (std::size_t k = 0; k < iterationsFor(MODEL_SIZES[i]); k++) {
+                voxel::Model model;
+                benchmark.begin();
+                voxel::loadModel(platform, path.data(), options, model, &arena);
+                arena.reset();
+                benchmark.end();
+                boxes = model.frames.size() ? model.frames[0].voxels.size() : 0;
+            }
+
+            benchmark.report("loadModel", std::size_t(MODEL_SIZES[i]), {{"voxels", voxelCounts[i]}, {"boxes", boxes}});
+        }
+    }
+    if (benchmark.isEnabled("loadPalette")) {
+        std::size_t textureBytes = renderingDevice->getTotalCounters().textureBytes;
+
+        for (std::size_t k = 0; k < 100; k++) {
+            benchmark.begin();
+            voxel::loadPalette(platform, renderingDevice, "data/palette.png");
+            benchmark.end();
+        }
+
+        benchmark.report("loadPalette", 256, {{"textureBytes", (renderingDevice->getTotalCounters().textureBytes - textureBytes) / 100}});
+    }
+    if (benchmark.isEnabled("loadMesh")) {
+        for (std::size_t i = 0; i < std::size(MODEL_SIZES); i++) {
+            std::string path = modelFolder(root, MODEL_SIZES[i]);
+            std::size_t gpuBytes = 0;
+            std::size_t buffers = 0;
+
+            for (std::size_t k = 0; k < iterationsFor(MODEL_SIZES[i]); k++) {
+                // new VoxelMeshes every iteration, otherwise mesh comes from cache
+                std::shared_ptr<voxel::VoxelMeshes> meshes = voxel::makeVoxelMeshes(platform, renderingDevice, camera, {});
+                HeadlessRenderingDevice::Counters before = renderingDevice->getTotalCounters();
+
+                benchmark.begin();
+                std::shared_ptr<voxel::VoxelMesh> mesh = meshes->loadMesh(path.data());
+                benchmark.end();
+
+                gpuBytes = renderingDevice->getTotalCounters().dataBytes - before.dataBytes;
+                buffers = renderingDevice->getTotalCounters().dataCreated - before.dataCreated;
+            }
+
+            benchmark.report("loadMesh", std::size_t(MODEL_SIZES[i]), {{"voxels", voxelCounts[i]}, {"buffers", buffers}, {"gpuBytes", gpuBytes}});
+        }
+    }
+    if (benchmark.isEnabled("updateAndDraw")) {
+        std::string path = modelFolder(root, DRAWN_MODEL_SIZE);
+
+        for (std::size_t meshCount : MESH_COUNTS) {
+            std::shared_ptr<voxel::VoxelMeshes> meshes = voxel::makeVoxelMeshes(platform, renderingDevice, camera, {});
+            std::vector<std::shared_ptr<voxel::VoxelMesh>> instances;
+            std::size_t side = std::size_t(std::ceil(std::sqrt(double(meshCount))));
+
+            // square grid of meshes in front of camera, all of them in view and at full detail
+            meshes->setLodDistances({});
+
+            for (std::size_t k = 0; k < meshCount; k++) {
+                math::transform3f transform = math::transform3f::identity();
+                transform.flat16[12] = (float(k % side) - float(side) * 0.5f) * float(DRAWN_MODEL_SIZE + 2);
+                transform.flat16[13] = (float(k / side) - float(side) * 0.5f) * float(DRAWN_MODEL_SIZE + 2);
+                transform.flat16[14] = -2.0f * float(side * (DRAWN_MODEL_SIZE + 2));
+
+                instances.emplace_back(meshes->loadMesh(path.data()));
+                instances.back()->setTransform(transform);
+                instances.back()->playAnimation("loop", voxel::VoxelMesh::Playback::LOOP, 1.0f + float(k % 7) * 0.1f);
+            }
+
+            benchmarkDraw(benchmark, "updateAndDraw", meshCount, *renderingDevice, *meshes);
+        }
+    }
+    if (benchmark.isEnabled("lod")) {
+        std::string path = modelFolder(root, LOD_MODEL_SIZE);
+
+        // the same scene with full detail at any distance and with default LOD distances
+        for (const char *name : {"lodFull", "lodChain"}) {
+            for (std::size_t meshCount : LOD_MESH_COUNTS) {
+                std::shared_ptr<voxel::VoxelMeshes> meshes = voxel::makeVoxelMeshes(platform, renderingDevice, camera, {});
+                std::vector<std::shared_ptr<voxel::VoxelMesh>> instances;
+
+                if (std::strcmp(name, "lodFull") == 0) {
+                    meshes->setLodDistances({});
+                }
+
+                for (std::size_t k = 0; k < meshCount; k++) {
+                    float distance = LOD_NEAR_DISTANCE + (LOD_FAR_DISTANCE - LOD_NEAR_DISTANCE) * float(k) / float(meshCount);
+                    math::transform3f transform = math::transform3f::identity();
+                    transform.flat16[12] = (float(k % 9) - 4.0f) * distance * 0.08f;
+                    transform.flat16[14] = -distance;
+
+                    instances.emplace_back(meshes->loadMesh(path.data()));
+                    instances.back()->setTransform(transform);
+                    instances.back()->playAnimation("loop", voxel::VoxelMesh::Playback::LOOP);
+                }
+
+                benchmarkDraw(benchmark, name, meshCount, *renderingDevice, *meshes);
+            }
+        }
+    }
+    if (benchmark.isEnabled("mode")) {
+        std::string path = modelFolder(root, PROP_MODEL_SIZE);
+
+        // the same props drawn as instanced voxels and as merged faces
+        for (voxel::VoxelMesh::RenderMode mode : {voxel::VoxelMesh::RenderMode::VOXELS, voxel::VoxelMesh::RenderMode::FACES}) {
+            for (std::size_t meshCount : PROP_MESH_COUNTS) {
+                std::shared_ptr<voxel::VoxelMeshes> meshes = voxel::makeVoxelMeshes(platform, renderingDevice, camera, {});
+                std::vector<std::shared_ptr<voxel::VoxelMesh>> instances;
+
+                // buffers created by loading and by the first frame (faces) are kept for fill area
+                renderingDevice->setKeepData(true);
+                meshes->setLodDistances({});
+
+                for (std::size_t k = 0; k < meshCount; k++) {
+                    math::transform3f transform = math::transform3f::identity();
+                    transform.flat16[12] = (float(k % 10) - 5.0f) * float(PROP_MODEL_SIZE + 4);
+                    transform.flat16[13] = (float(k / 10) - 5.0f) * float(PROP_MODEL_SIZE + 4);
+                    transform.flat16[14] = -10.0f * float(PROP_MODEL_SIZE);
+
+                    instances.emplace_back(meshes->loadMesh(path.data()));
+                    instances.back()->setTransform(transform);
+                    instances.back()->setRenderMode(mode);
+                }
+
+                renderingDevice->prepareFrame();
+                meshes->updateAndDraw(1.0f / 60.0f);
+
+                std::size_t fillArea = getFillArea(*renderingDevice, mode);
+                std::size_t gpuBytes = instances[0]->getGpuBytes();
+                renderingDevice->setKeepData(false);
+
+                const char *name = mode == voxel::VoxelMesh::RenderMode::FACES ? "modeFaces" : "modeVoxels";
+                benchmarkDraw(benchmark, name, meshCount, *renderingDevice, *meshes, {{"fillArea", fillArea}, {"gpuBytes", gpuBytes}});
+            }
+        }
+    }
+
+    if (benchmark.isEnabled("kernel")) {
+        const voxel::VoxelKernels &scalar = voxel::getScalarVoxelKernels();
+        const voxel::VoxelKernels &best = voxel::getVoxelKernels();
+        const std::int16_t offset[3] = {-64, 0, -64};
+        std::mt19937 random (1);
+
+        for (std::size_t count : KERNEL_RECORD_COUNTS) {
+            std::vector<std::uint8_t> xyzi (count * 4), cells (count);
+            std::vector<voxel::Voxel> voxels[2] = {std::vector<voxel::Voxel>(count), std::vector<voxel::Voxel>(count)};
+            std::vector<std::uint64_t> bits[2] = {std::vector<std::uint64_t>((count + 63) / 64), std::vector<std::uint64_t>((count + 63) / 64)};
+            std::uint8_t minXYZI[2][3], maxXYZI[2][3];
+            std::int32_t minVoxels[2][3], maxVoxels[2][3];
+
+            // every third cell is filled
+            for (std::size_t i = 0; i < xyzi.size(); i++) {
+                xyzi[i] = std::uint8_t(random());
+            }
+            for (std::size_t i = 0; i < cells.size(); i++) {
+                cells[i] = random() % 3 ? 0 : std::uint8_t(random());
+            }
+
+            // index 0 is scalar, bounds of voxels are taken from its decoded ones
+            for (std::size_t k = 0; k < 2; k++) {
+                const voxel::VoxelKernels &kernels = k ? best : scalar;
+                std::string suffix = std::string(".") + kernels.name;
+
+                benchmarkKernel(benchmark, "kernelDecode" + suffix, count, [&]() {
+                    kernels.decodeXYZI(xyzi.data(), count, offset, voxels[k].data());
+                });
+                benchmarkKernel(benchmark, "kernelBoundsXYZI" + suffix, count, [&]() {
+                    kernels.boundsXYZI(xyzi.data(), count, minXYZI[k], maxXYZI[k]);
+                });
+                benchmarkKernel(benchmark, "kernelBoundsVoxels" + suffix, count, [&]() {
+                    kernels.boundsVoxels(voxels[0].data(), count, minVoxels[k], maxVoxels[k]);
+                });
+                benchmarkKernel(benchmark, "kernelOccupancy" + suffix, count, [&]() {
+                    kernels.occupancy(cells.data(), count, bits[k].data());
+                });
+            }
+
+            if (std::memcmp(voxels[0].data(), voxels[1].data(), count * sizeof(voxel::Voxel)) != 0) {
+                platform->logError("decodeXYZI results of %s and scalar kernels differ", best.name);
+            }
+            if (std::memcmp(minXYZI[0], minXYZI[1], 3) != 0 || std::memcmp(maxXYZI[0], maxXYZI[1], 3) != 0) {
+                platform->logError("boundsXYZI results of %s and scalar kernels differ", best.name);
+            }
+            if (std::memcmp(minVoxels[0], minVoxels[1], sizeof(minVoxels[0])) != 0 || std::memcmp(maxVoxels[0], maxVoxels[1], sizeof(maxVoxels[0])) != 0) {
+                platform->logError("boundsVoxels results of %s and scalar kernels differ", best.name);
+            }
+            if (bits[0] != bits[1]) {
+                platform->logError("occupancy results of %s and scalar kernels differ", best.name);
+            }
+        }
+    }
+
+    if (benchmark.isEnabled("worldEdit")) {
+        for (std::int32_t size : WORLD_EDIT_SIZES) {
+            std::shared_ptr<voxel::VoxelMeshes> meshes = voxel::makeVoxelMeshes(platform, renderingDevice, camera, {});
+            std::shared_ptr<voxel::VoxelWorld> world = voxel::makeVoxelWorld(platform, renderingDevice, camera, meshes);
+            std::uint32_t chunksRebuilt = 0;
+
+            // rolling terrain in front of camera, fully rebuilt before edits
+            for (std::int32_t z = 0; z < WORLD_SIDE; z++) {
+                for (std::int32_t x = 0; x < WORLD_SIDE; x++) {
+                    std::int32_t height = WORLD_HEIGHT / 2 + std::int32_t(float(WORLD_HEIGHT / 2 - 1) * std::sin(float(x) * 0.05f) * std::cos(float(z) * 0.07f));
+                    const std::int32_t min[3] = {x - WORLD_SIDE / 2, -WORLD_HEIGHT, -z - 32};
+                    const std::int32_t max[3] = {x - WORLD_SIDE / 2, height - WORLD_HEIGHT, -z - 32};
+                    world->fillBox(min, max, std::uint8_t(1 + height / 4));
+                }
+            }
+
+            world->setRebuildBudget(std::numeric_limits<float>::max());
+            renderingDevice->prepareFrame();
+            world->updateAndDraw();
+
+            // boxes are filled and cleared in turn along a diagonal, every edit is rebuilt within its frame
+            for (std::size_t k = 0; k < WORLD_EDITS; k++) {
+                std::int32_t offset = std::int32_t(k / 2) * (WORLD_SIDE - size) / std::int32_t(WORLD_EDITS / 2);
+                const std::int32_t min[3] = {offset - WORLD_SIDE / 2, -WORLD_HEIGHT, -offset - size - 32};
+                const std::int32_t max[3] = {offset - WORLD_SIDE / 2 + size - 1, size - WORLD_HEIGHT - 1, -offset - 33};
+
+                renderingDevice->prepareFrame();
+                benchmark.begin();
+
+                if (k % 2) {
+                    world->clearBox(min, max);
+                }
+                else {
+                    world->fillBox(min, max, 200);
+                }
+
+                world->updateAndDraw();
+                benchmark.end();
+                chunksRebuilt = std::max(chunksRebuilt, world->getStatistics().chunksRebuilt);
+            }
+
+            voxel::VoxelWorld::Statistics statistics = world->getStatistics();
+            benchmark.report("worldEdit", std::size_t(size), {
+                {"chunks", statistics.chunks},
+                {"chunksRebuilt", chunksRebuilt},
+                {"instances", statistics.instancesSubmitted},
+                {"gpuBytes", statistics.gpuBytes},
+                {"cellBytes", statistics.cellBytes}
+            });
+        }
+    }
+
+    return platform->getErrorCount() == 0 ? 0 : 1;
+}
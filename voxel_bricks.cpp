@@ -0,0 +1,174 @@
+#include "voxel_bricks.h"
+#include "voxel_kernels.h"
+
+#include <algorithm>
+
+namespace voxel {
+    BrickVolume::BrickVolume(const std::int32_t (&min)[3], const std::int32_t (&size)[3]) {
+        for (int a = 0; a < 3; a++) {
+            _min[a] = min[a];
+            _size[a] = std::max(size[a], 0);
+            _bricks[a] = (_size[a] + BRICK_SIZE - 1) / BRICK_SIZE;
+        }
+        
+        _brickIndices.assign(std::size_t(_bricks[0]) * _bricks[1] * _bricks[2], -1);
+    }
+
+    BrickVolume BrickVolume::fromVoxels(const Voxel *voxels, std::size_t voxelCount) {
+        std::int32_t lo[3], hi[3];
+        
+        if (voxelCount == 0) {
+            return BrickVolume();
+        }
+        
+        getVoxelKernels().boundsVoxels(voxels, voxelCount, lo, hi);
+        
+        BrickVolume result (lo, {hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]});
+        
+        for (std::size_t i = 0; i < voxelCount; i++) {
+            const Voxel &v = voxels[i];
+            
+            for (std::int32_t z = v.positionZ; z < v.positionZ + v.scaleZ; z++) {
+                for (std::int32_t y = v.positionY; y < v.positionY + v.scaleY; y++) {
+                    for (std::int32_t x = v.positionX; x < v.positionX + v.scaleX; x++) {
+                        result.set(x, y, z, v.colorIndex);
+                    }
+                }
+            }
+        }
+        
+        return result;
+    }
+
+    bool BrickVolume::set(std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t colorIndex) {
+        std::int32_t *index = _findBrickIndex(x, y, z);
+        
+        if (index == nullptr) {
+            return false;
+        }
+        if (*index < 0) {
+            if (_freeBricks.size()) {
+                *index = _freeBricks.back();
+                _freeBricks.pop_back();
+            }
+            else {
+                *index = std::int32_t(_brickStorage.size());
+                _brickStorage.emplace_back();
+            }
+        }
+        
+        Brick &brick = _brickStorage[*index];
+        std::int32_t layer = (z - _min[2]) & (BRICK_SIZE - 1);
+        std::int32_t bit = _bit(x - _min[0], y - _min[1]);
+        std::int32_t cell = layer * BRICK_SIZE * BRICK_SIZE + bit;
+        bool occupied = (brick.occupancy[layer] >> bit & 1) != 0;
+        
+        if (occupied && brick.palette[_readIndex(brick, cell)] == colorIndex) {
+            return false;
+        }
+        
+        std::uint32_t paletteIndex = std::uint32_t(std::find(brick.palette.begin(), brick.palette.end(), colorIndex) - brick.palette.begin());
+        
+        if (paletteIndex == brick.palette.size()) {
+            // palette is full for current index width: repack every cell with doubled width
+            if (brick.palette.size() == (std::size_t(1) << brick.bits)) {
+                std::uint8_t bits = brick.bits ? std::uint8_t(brick.bits * 2) : 1;
+                std::vector<std::uint64_t> indices (BRICK_CELL_COUNT * bits / 64, 0);
+                
+                for (std::int32_t i = 0; i < BRICK_CELL_COUNT; i++) {
+                    std::uint32_t offset = std::uint32_t(i) * bits;
+                    indices[offset >> 6] |= std::uint64_t(_readIndex(brick, i)) << (offset & 63);
+                }
+                
+                brick.bits = bits;
+                brick.indices = std::move(indices);
+            }
+            
+            brick.palette.emplace_back(colorIndex);
+        }
+        if (brick.bits) {
+            std::uint32_t offset = std::uint32_t(cell) * brick.bits;
+            std::uint64_t mask = ((std::uint64_t(1) << brick.bits) - 1) << (offset & 63);
+            brick.indices[offset >> 6] = (brick.indices[offset >> 6] & ~mask) | std::uint64_t(paletteIndex) << (offset & 63);
+        }
+        if (occupied == false) {
+            brick.occupancy[layer] |= std::uint64_t(1) << bit;
+            brick.cellCount++;
+            _cellCount++;
+        }
+        
+        return true;
+    }
+
+    bool BrickVolume::clear(std::int32_t x, std::int32_t y, std::int32_t z) {
+        std::int32_t *index = _findBrickIndex(x, y, z);
+        
+        if (index == nullptr || *index < 0) {
+            return false;
+        }
+        
+        Brick &brick = _brickStorage[*index];
+        std::int32_t layer = (z - _min[2]) & (BRICK_SIZE - 1);
+        std::int32_t bit = _bit(x - _min[0], y - _min[1]);
+        
+        if ((brick.occupancy[layer] >> bit & 1) == 0) {
+            return false;
+        }
+        
+        brick.occupancy[layer] &= ~(std::uint64_t(1) << bit);
+        brick.cellCount--;
+        _cellCount--;
+        
+        if (brick.cellCount == 0) {
+            brick = Brick();
+            _freeBricks.emplace_back(*index);
+            *index = -1;
+        }
+        
+        return true;
+    }
+
+    bool BrickVolume::get(std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t &colorIndex) const {
+        const Brick *brick = _findBrick(x, y, z);
+        
+        if (brick) {
+            std::int32_t layer = (z - _min[2]) & (BRICK_SIZE - 1);
+            std::int32_t bit = _bit(x - _min[0], y - _min[1]);
+            
+            if (brick->occupancy[layer] >> bit & 1) {
+                colorIndex = brick->palette[_readIndex(*brick, layer * BRICK_SIZE * BRICK_SIZE + bit)];
+                return true;
+            }
+        }
+        
+        return false;
+    }
+
+    void BrickVolume::toVoxels(std::vector<Voxel> &voxels, std::vector<std::uint8_t> &scratch) const {
+        std::size_t start = voxels.size();
+        
+        scratch.assign(std::size_t(_size[0]) * _size[1] * _size[2], 0);
+        
+        forEach([&](std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t colorIndex) {
+            scratch[(std::size_t(z - _min[2]) * _size[1] + (y - _min[1])) * _size[0] + (x - _min[0])] = std::uint8_t(colorIndex + 1);
+        });
+        
+        mergeCells(scratch.data(), _size[0], _size[1], _size[2], voxels);
+        
+        for (std::size_t i = start; i < voxels.size(); i++) {
+            voxels[i].positionX = std::int16_t(voxels[i].positionX + _min[0]);
+            voxels[i].positionY = std::int16_t(voxels[i].positionY + _min[1]);
+            voxels[i].positionZ = std::int16_t(voxels[i].positionZ + _min[2]);
+        }
+    }
+
+    std::size_t BrickVolume::getMemoryBytes() const {
+        std::size_t result = _brickIndices.capacity() * sizeof(std::int32_t) + _brickStorage.capacity() * sizeof(Brick) + _freeBricks.capacity() * sizeof(std::int32_t);
+        
+        for (const Brick &brick : _brickStorage) {
+            result += brick.palette.capacity() + brick.indices.capacity() * sizeof(std::uint64_t);
+        }
+        
+        return result;
+    }
+}
@@ -0,0 +1,151 @@
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "voxel_utility.h"
+
+namespace voxel {
+    // Sparse storage of cells within fixed bounds. Cells are grouped into BRICK_SIZE^3 bricks, empty bricks take only their index.
+    // Brick keeps occupancy bits and colors as indices in its own palette, packed by 0 (single color), 1, 2, 4 or 8 bits.
+    // Palette entries stay when cells are cleared, brick is released when its last cell is cleared.
+    // Colors are in [0, 254] like voxels of .vox models.
+    //
+    class BrickVolume {
+    public:
+        static constexpr std::int32_t BRICK_SIZE = 8;
+        static constexpr std::int32_t BRICK_CELL_COUNT = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+        
+        BrickVolume() = default;
+        
+        // Cells [min, min + size) on every axis
+        //
+        BrickVolume(const std::int32_t (&min)[3], const std::int32_t (&size)[3]);
+        
+        // Volume bounding all voxels, box voxel fills cells [position, position + scale)
+        //
+        static BrickVolume fromVoxels(const Voxel *voxels, std::size_t voxelCount);
+        
+        // Both return true if cell is changed. Cells outside bounds are not changed.
+        //
+        bool set(std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t colorIndex);
+        bool clear(std::int32_t x, std::int32_t y, std::int32_t z);
+        
+        bool get(std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t &colorIndex) const;
+        
+        bool isOccupied(std::int32_t x, std::int32_t y, std::int32_t z) const {
+            const Brick *brick = _findBrick(x, y, z);
+            return brick && (brick->occupancy[(z - _min[2]) & (BRICK_SIZE - 1)] >> _bit(x - _min[0], y - _min[1]) & 1) != 0;
+        }
+        
+        // Brick containing cell has no filled cells (or cell is outside bounds)
+        //
+        bool isBrickEmpty(std::int32_t x, std::int32_t y, std::int32_t z) const {
+            return _findBrick(x, y, z) == nullptr;
+        }
+        
+        // Calls @visit(x, y, z, colorIndex) for every filled cell, brick by brick
+        //
+        template<typename VISIT> void forEach(VISIT &&visit) const {
+            for (std::int32_t bz = 0; bz < _bricks[2]; bz++) {
+                for (std::int32_t by = 0; by < _bricks[1]; by++) {
+                    for (std::int32_t bx = 0; bx < _bricks[0]; bx++) {
+                        std::int32_t index = _brickIndices[(std::size_t(bz) * _bricks[1] + by) * _bricks[0] + bx];
+                        
+                        if (index < 0) {
+                            continue;
+                        }
+                        
+                        const Brick &brick = _brickStorage[index];
+                        
+                        for (std::int32_t lz = 0; lz < BRICK_SIZE; lz++) {
+                            for (std::uint64_t word = brick.occupancy[lz]; word; word &= word - 1) {
+                                std::int32_t bit = __builtin_ctzll(word);
+                                std::int32_t cell = lz * BRICK_SIZE * BRICK_SIZE + bit;
+                                visit(_min[0] + bx * BRICK_SIZE + bit % BRICK_SIZE, _min[1] + by * BRICK_SIZE + bit / BRICK_SIZE, _min[2] + bz * BRICK_SIZE + lz, brick.palette[_readIndex(brick, cell)]);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        
+        // Cells merged into boxes of upload layout, positions are cell coordinates. @scratch keeps dense grid between calls.
+        //
+        void toVoxels(std::vector<Voxel> &voxels, std::vector<std::uint8_t> &scratch) const;
+        
+        const std::int32_t (&getMin() const)[3] {
+            return _min;
+        }
+        
+        const std::int32_t (&getSize() const)[3] {
+            return _size;
+        }
+        
+        std::size_t getCellCount() const {
+            return _cellCount;
+        }
+        
+        std::size_t getBrickCount() const {
+            return _brickStorage.size() - _freeBricks.size();
+        }
+        
+        std::size_t getMemoryBytes() const;
+
+    private:
+        struct Brick {
+            std::uint64_t occupancy[BRICK_SIZE] = {}; // word per layer, bit (y * BRICK_SIZE + x)
+            std::uint16_t cellCount = 0;
+            std::uint8_t bits = 0;
+            std::vector<std::uint8_t> palette;
+            std::vector<std::uint64_t> indices; // BRICK_CELL_COUNT * bits / 64 words, cell (z * BRICK_SIZE + y) * BRICK_SIZE + x
+        };
+        
+        std::int32_t _min[3] = {0, 0, 0};
+        std::int32_t _size[3] = {0, 0, 0};
+        std::int32_t _bricks[3] = {0, 0, 0};
+        std::size_t _cellCount = 0;
+        std::vector<std::int32_t> _brickIndices; // -1 for empty brick
+        std::vector<Brick> _brickStorage;
+        std::vector<std::int32_t> _freeBricks;
+        
+        // @x, @y are relative to _min
+        //
+        static std::int32_t _bit(std::int32_t x, std::int32_t y) {
+            return (y & (BRICK_SIZE - 1)) * BRICK_SIZE + (x & (BRICK_SIZE - 1));
+        }
+        
+        static std::uint32_t _readIndex(const Brick &brick, std::int32_t cell) {
+            if (brick.bits == 0) {
+                return 0;
+            }
+            
+            std::uint32_t offset = std::uint32_t(cell) * brick.bits;
+            return std::uint32_t(brick.indices[offset >> 6] >> (offset & 63)) & ((1u << brick.bits) - 1);
+        }
+        
+        // Bounds are relative to _min, so bricks are aligned to it
+        //
+        std::int32_t *_findBrickIndex(std::int32_t x, std::int32_t y, std::int32_t z) {
+            return const_cast<std::int32_t *>(static_cast<const BrickVolume *>(this)->_findBrickIndex(x, y, z));
+        }
+        
+        const std::int32_t *_findBrickIndex(std::int32_t x, std::int32_t y, std::int32_t z) const {
+            x -= _min[0];
+            y -= _min[1];
+            z -= _min[2];
+            
+            if (x < 0 || y < 0 || z < 0 || x >= _size[0] || y >= _size[1] || z >= _size[2]) {
+                return nullptr;
+            }
+            
+            return &_brickIndices[(std::size_t(z / BRICK_SIZE) * _bricks[1] + y / BRICK_SIZE) * _bricks[0] + x / BRICK_SIZE];
+        }
+        
+        const Brick *_findBrick(std::int32_t x, std::int32_t y, std::int32_t z) const {
+            const std::int32_t *index = _findBrickIndex(x, y, z);
+            return index && *index >= 0 ? &_brickStorage[*index] : nullptr;
+        }
+    };
+}
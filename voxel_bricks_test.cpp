@@ -0,0 +1,285 @@
+// Tests of BrickVolume against dense reference grids, exit code is the count of failed checks:
+// - one brick is filled with 1, 2, 3, 5, 17 and 255 colors, so its indices are repacked 0 -> 1 -> 2 -> 4 -> 8 bits,
+//   then cleared back to empty. Every cell is compared to reference after filling and during clearing.
+// - bricks released by clearing go to free list and are reused by the next filled brick
+// - fromVoxels of boxes, toVoxels round trip through mergeCells with non-zero volume origin
+//
+// Usage: voxel_bricks_test
+// Build:
+//   g++ -std=c++17 -O2 -I<include path> voxel_bricks_test.cpp voxel_bricks.cpp voxel_utility.cpp voxel_kernels.cpp -lpthread
+//
+#include "voxel_bricks.h"
+#include "voxel_kernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+    const std::int32_t BRICK_SIZE = voxel::BrickVolume::BRICK_SIZE;
+    const std::int32_t BRICK_CELL_COUNT = voxel::BrickVolume::BRICK_CELL_COUNT;
+    const std::size_t BRICK_COLOR_COUNTS[] = {1, 2, 3, 5, 17, 255};
+
+    int failures = 0;
+
+    void check(bool condition, const char *description) {
+        if (condition == false) {
+            printf("FAILED: %s\n", description);
+            failures++;
+        }
+    }
+
+    // Cells of box [min, min + size), 0 is empty, otherwise colorIndex + 1
+    //
+    class DenseGrid {
+    public:
+        DenseGrid(const std::int32_t (&min)[3], const std::int32_t (&size)[3]) : _cells(std::size_t(size[0]) * size[1] * size[2], 0) {
+            std::copy(min, min + 3, _min);
+            std::copy(size, size + 3, _size);
+        }
+
+        std::uint8_t &at(std::int32_t x, std::int32_t y, std::int32_t z) {
+            return _cells[(std::size_t(z - _min[2]) * _size[1] + (y - _min[1])) * _size[0] + (x - _min[0])];
+        }
+
+        // Every cell of grid and one cell layer around it is the same in volume
+        //
+        bool equals(const voxel::BrickVolume &volume) {
+            for (std::int32_t z = _min[2] - 1; z <= _min[2] + _size[2]; z++) {
+                for (std::int32_t y = _min[1] - 1; y <= _min[1] + _size[1]; y++) {
+                    for (std::int32_t x = _min[0] - 1; x <= _min[0] + _size[0]; x++) {
+                        bool inside = x >= _min[0] && y >= _min[1] && z >= _min[2] && x < _min[0] + _size[0] && y < _min[1] + _size[1] && z < _min[2] + _size[2];
+                        std::uint8_t expected = inside ? at(x, y, z) : 0;
+                        std::uint8_t colorIndex = 0;
+                        bool filled = volume.get(x, y, z, colorIndex);
+
+                        if (filled != (expected != 0) || volume.isOccupied(x, y, z) != filled || (filled && colorIndex + 1 != expected)) {
+                            return false;
+                        }
+                    }
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        std::int32_t _min[3];
+        std::int32_t _size[3];
+        std::vector<std::uint8_t> _cells;
+    };
+
+    // Memory of one-brick volume besides its palette and indices: the first brick with one color has no indices
+    //
+    std::size_t getBaseBytes(const std::int32_t (&min)[3], const std::int32_t (&size)[3]) {
+        voxel::BrickVolume volume (min, size);
+        volume.set(min[0], min[1], min[2], 0);
+        return volume.getMemoryBytes() - 1;
+    }
+
+    void testBrickColors() {
+        const std::int32_t min[3] = {-3, 4, -20};
+        const std::int32_t size[3] = {BRICK_SIZE, BRICK_SIZE, BRICK_SIZE};
+        std::size_t baseBytes = getBaseBytes(min, size);
+        std::mt19937 random (7);
+
+        for (std::size_t colorCount : BRICK_COLOR_COUNTS) {
+            voxel::BrickVolume volume (min, size);
+            DenseGrid reference (min, size);
+            std::vector<std::uint8_t> colors (colorCount);
+            std::vector<std::int32_t> cells (BRICK_CELL_COUNT);
+            bool changed = true;
+
+            for (std::size_t i = 0; i < colorCount; i++) {
+                colors[i] = std::uint8_t((i * 37 + 11) % 255);
+            }
+
+            // every color is used, cells are written in random order and some are overwritten by other colors
+            std::iota(cells.begin(), cells.end(), 0);
+            std::shuffle(cells.begin(), cells.end(), random);
+
+            for (std::size_t k = 0; k < cells.size() * 3 / 2; k++) {
+                std::int32_t cell = cells[k % cells.size()];
+                std::int32_t x = min[0] + cell % BRICK_SIZE, y = min[1] + cell / BRICK_SIZE % BRICK_SIZE, z = min[2] + cell / (BRICK_SIZE * BRICK_SIZE);
+                std::uint8_t colorIndex = colors[(k * 13) % colorCount];
+                bool expected = reference.at(x, y, z) != colorIndex + 1;
+
+                changed = changed && volume.set(x, y, z, colorIndex) == expected;
+                reference.at(x, y, z) = std::uint8_t(colorIndex + 1);
+            }
+
+            // palette keeps every color, indices take BRICK_CELL_COUNT * bits / 8 bytes
+            std::size_t bits = colorCount <= 1 ? 0 : colorCount <= 2 ? 1 : colorCount <= 4 ? 2 : colorCount <= 16 ? 4 : 8;
+            std::size_t indexBytes = BRICK_CELL_COUNT * bits / 8;
+            std::size_t paletteBytes = volume.getMemoryBytes() - baseBytes - std::min(indexBytes, volume.getMemoryBytes() - baseBytes);
+
+            check(changed, "set returns true only if cell is changed");
+            check(volume.getCellCount() == std::size_t(BRICK_CELL_COUNT) && volume.getBrickCount() == 1, "filled brick counts all its cells");
+            check(reference.equals(volume), "filled brick matches reference");
+            check(volume.getMemoryBytes() >= baseBytes + indexBytes && paletteBytes >= colorCount && paletteBytes <= colorCount * 2, "indices are packed by the narrowest width for color count");
+
+            bool cleared = true;
+            bool matches = true;
+            std::shuffle(cells.begin(), cells.end(), random);
+
+            for (std::size_t k = 0; k < cells.size(); k++) {
+                std::int32_t cell = cells[k];
+                std::int32_t x = min[0] + cell % BRICK_SIZE, y = min[1] + cell / BRICK_SIZE % BRICK_SIZE, z = min[2] + cell / (BRICK_SIZE * BRICK_SIZE);
+
+                cleared = cleared && volume.clear(x, y, z) && volume.clear(x, y, z) == false;
+                reference.at(x, y, z) = 0;
+
+                if (k % 97 == 0 || k + 1 == cells.size()) {
+                    matches = matches && reference.equals(volume);
+                }
+            }
+
+            check(cleared, "clear returns true only for filled cell");
+            check(matches, "brick matches reference while it's cleared");
+            check(volume.getCellCount() == 0 && volume.getBrickCount() == 0 && volume.isBrickEmpty(min[0], min[1], min[2]), "cleared brick is released");
+        }
+    }
+
+    void testBounds() {
+        const std::int32_t min[3] = {10, -10, 0};
+        const std::int32_t size[3] = {5, 9, 1};
+        voxel::BrickVolume volume (min, size);
+        std::uint8_t colorIndex = 0;
+
+        check(volume.set(9, -10, 0, 1) == false && volume.set(15, -10, 0, 1) == false && volume.set(10, -1, 0, 1) == false, "set outside bounds changes nothing");
+        check(volume.set(14, -2, 0, 1) && volume.get(14, -2, 0, colorIndex) && colorIndex == 1, "set at the last cell of bounds");
+        check(volume.set(14, -2, 0, 1) == false, "set of the same color changes nothing");
+        check(volume.clear(14, -2, 1) == false && volume.clear(13, -2, 0) == false, "clear of empty or outside cell changes nothing");
+        check(volume.getCellCount() == 1 && volume.getBrickCount() == 1, "partial brick at bounds holds cell");
+    }
+
+    void testFreeBricks() {
+        const std::int32_t min[3] = {0, 0, 0};
+        const std::int32_t size[3] = {BRICK_SIZE * 4, BRICK_SIZE, BRICK_SIZE};
+        voxel::BrickVolume volume (min, size);
+
+        // two bricks, the first one is released and the next filled brick takes its storage.
+        // New brick would add more than its occupancy words (64 bytes), free list adds an index.
+        volume.set(0, 0, 0, 1);
+        volume.set(BRICK_SIZE, 0, 0, 2);
+        std::size_t bytes = volume.getMemoryBytes();
+
+        volume.clear(0, 0, 0);
+        check(volume.getBrickCount() == 1 && volume.isBrickEmpty(0, 0, 0) && volume.isBrickEmpty(BRICK_SIZE, 0, 0) == false, "brick without cells is released");
+
+        volume.set(BRICK_SIZE * 3, 1, 1, 3);
+        std::uint8_t colorIndex = 0;
+        check(volume.getBrickCount() == 2, "released brick is reused");
+        check(volume.getMemoryBytes() < bytes + 64, "reused brick takes no more storage");
+        check(volume.get(BRICK_SIZE * 3, 1, 1, colorIndex) && colorIndex == 3 && volume.isOccupied(BRICK_SIZE * 3, 0, 0) == false, "reused brick starts empty");
+        check(volume.get(BRICK_SIZE, 0, 0, colorIndex) && colorIndex == 2, "other brick keeps its cell");
+
+        volume.clear(BRICK_SIZE, 0, 0);
+        volume.clear(BRICK_SIZE * 3, 1, 1);
+        volume.set(BRICK_SIZE * 2, 0, 0, 4);
+        volume.set(BRICK_SIZE * 3, 0, 0, 5);
+        check(volume.getBrickCount() == 2 && volume.getMemoryBytes() < bytes + 64, "every released brick is reused before storage grows");
+    }
+
+    void testFromVoxels() {
+        // boxes don't overlap, one of them crosses several bricks
+        const voxel::Voxel voxels[] = {
+            {-5, 2, 7, 0, 1, 1, 1, 3},
+            {-4, 2, 7, 0, 12, 3, 9, 200},
+            {20, -6, 0, 0, 2, 1, 2, 0},
+        };
+        voxel::BrickVolume volume = voxel::BrickVolume::fromVoxels(voxels, std::size(voxels));
+        std::int32_t lo[3], hi[3];
+        std::size_t cellCount = 0;
+        bool filled = true;
+
+        voxel::getScalarVoxelKernels().boundsVoxels(voxels, std::size(voxels), lo, hi);
+
+        for (const voxel::Voxel &v : voxels) {
+            cellCount += std::size_t(v.scaleX) * v.scaleY * v.scaleZ;
+
+            for (std::int32_t z = v.positionZ; z < v.positionZ + v.scaleZ; z++) {
+                for (std::int32_t y = v.positionY; y < v.positionY + v.scaleY; y++) {
+                    for (std::int32_t x = v.positionX; x < v.positionX + v.scaleX; x++) {
+                        std::uint8_t colorIndex = 0;
+                        filled = filled && volume.get(x, y, z, colorIndex) && colorIndex == v.colorIndex;
+                    }
+                }
+            }
+        }
+
+        const std::int32_t (&min)[3] = volume.getMin();
+        const std::int32_t (&size)[3] = volume.getSize();
+        check(min[0] == lo[0] && min[1] == lo[1] && min[2] == lo[2], "volume starts at the lowest cell of boxes");
+        check(size[0] == hi[0] - lo[0] && size[1] == hi[1] - lo[1] && size[2] == hi[2] - lo[2], "volume ends after the highest cell of boxes");
+        check(filled && volume.getCellCount() == cellCount, "every cell of boxes is filled with box color");
+        check(voxel::BrickVolume::fromVoxels(nullptr, 0).getCellCount() == 0, "no voxels give empty volume");
+    }
+
+    void testToVoxels() {
+        const std::int32_t min[3] = {-13, 5, 100};
+        const std::int32_t size[3] = {20, 17, 9};
+        voxel::BrickVolume volume (min, size);
+        DenseGrid reference (min, size);
+        DenseGrid covered (min, size);
+        std::mt19937 random (3);
+
+        // runs of a few colors, so cells are merged into boxes of different shapes
+        for (std::int32_t z = min[2]; z < min[2] + size[2]; z++) {
+            for (std::int32_t y = min[1]; y < min[1] + size[1]; y++) {
+                for (std::int32_t x = min[0]; x < min[0] + size[0]; x++) {
+                    if (random() % 4) {
+                        std::uint8_t colorIndex = std::uint8_t((x / 3 + y / 4 + (random() % 8 == 0)) % 3 + 40);
+                        volume.set(x, y, z, colorIndex);
+                        reference.at(x, y, z) = std::uint8_t(colorIndex + 1);
+                    }
+                }
+            }
+        }
+
+        std::vector<voxel::Voxel> voxels = {voxel::Voxel {0, 0, 0, 0, 1, 1, 1, 9}};
+        std::vector<std::uint8_t> scratch;
+        bool disjoint = true;
+
+        volume.toVoxels(voxels, scratch);
+        check(voxels.size() > 1 && voxels[0].colorIndex == 9, "voxels are appended");
+
+        for (std::size_t i = 1; i < voxels.size(); i++) {
+            const voxel::Voxel &v = voxels[i];
+
+            for (std::int32_t z = v.positionZ; z < v.positionZ + v.scaleZ; z++) {
+                for (std::int32_t y = v.positionY; y < v.positionY + v.scaleY; y++) {
+                    for (std::int32_t x = v.positionX; x < v.positionX + v.scaleX; x++) {
+                        bool inside = x >= min[0] && y >= min[1] && z >= min[2] && x < min[0] + size[0] && y < min[1] + size[1] && z < min[2] + size[2];
+                        disjoint = disjoint && inside && covered.at(x, y, z) == 0;
+
+                        if (inside) {
+                            covered.at(x, y, z) = std::uint8_t(v.colorIndex + 1);
+                        }
+                    }
+                }
+            }
+        }
+
+        check(disjoint, "boxes are disjoint and lie in volume at its origin");
+        check(covered.equals(volume) && reference.equals(volume), "boxes cover exactly filled cells with their colors");
+        check(voxels.size() - 1 < volume.getCellCount(), "cells are merged");
+
+        voxel::BrickVolume restored = voxel::BrickVolume::fromVoxels(voxels.data() + 1, voxels.size() - 1);
+        check(reference.equals(restored), "fromVoxels of toVoxels restores cells");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    testBrickColors();
+    testBounds();
+    testFreeBricks();
+    testFromVoxels();
+    testToVoxels();
+
+    printf("%s: %d failed checks\n", argc ? argv[0] : "voxel_bricks_test", failures);
+    return failures;
+}
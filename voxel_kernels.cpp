@@ -0,0 +1,307 @@
+#include "voxel_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VOXEL_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Output of 4 voxels (48 bytes) as three 16-byte vectors: byte shuffle of 4 XYZI records plus 16-bit lane constants.
+    // Position lanes get zero-extended coordinate plus offset, scale lanes get 0x0101,
+    // scaleZ / colorIndex lane gets (i << 8) + 0xff01 = (i - 1) << 8 | 1.
+    //
+    void makeDecodeTables(const std::int16_t (&offset)[3], std::int8_t (&shuffle)[3][16], std::int16_t (&add)[3][8]) {
+        for (int k = 0; k < 48; k++) {
+            int v = k / 12, o = k % 12;
+            shuffle[k / 16][k % 16] = std::int8_t(o == 0 ? 4 * v + 1 : o == 2 ? 4 * v + 2 : o == 4 ? 4 * v : o == 11 ? 4 * v + 3 : -128);
+        }
+        for (int l = 0; l < 24; l++) {
+            int o = l * 2 % 12;
+            add[l / 8][l % 8] = std::int16_t(o == 0 ? offset[0] : o == 2 ? offset[1] : o == 4 ? offset[2] : o == 8 ? 0x0101 : o == 10 ? -255 : 0);
+        }
+    }
+
+    void decodeXYZIScalar(const std::uint8_t *xyzi, std::size_t count, const std::int16_t (&offset)[3], voxel::Voxel *voxels) {
+        for (std::size_t i = 0; i < count; i++) {
+            const std::uint8_t *record = xyzi + i * 4;
+            voxel::Voxel &v = voxels[i];
+            v.positionX = std::int16_t(record[1] + offset[0]);
+            v.positionY = std::int16_t(record[2] + offset[1]);
+            v.positionZ = std::int16_t(record[0] + offset[2]);
+            v.reserved = 0;
+            v.scaleX = v.scaleY = v.scaleZ = 1;
+            v.colorIndex = std::uint8_t(record[3] - 1);
+        }
+    }
+
+    void boundsXYZIScalar(const std::uint8_t *xyzi, std::size_t count, std::uint8_t (&min)[3], std::uint8_t (&max)[3]) {
+        for (int a = 0; a < 3; a++) {
+            min[a] = 0xff;
+            max[a] = 0;
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            for (int a = 0; a < 3; a++) {
+                min[a] = std::min(min[a], xyzi[i * 4 + a]);
+                max[a] = std::max(max[a], xyzi[i * 4 + a]);
+            }
+        }
+    }
+
+    void boundsVoxelsScalar(const voxel::Voxel *voxels, std::size_t count, std::int32_t (&min)[3], std::int32_t (&max)[3]) {
+        for (int a = 0; a < 3; a++) {
+            min[a] = std::numeric_limits<std::int32_t>::max();
+            max[a] = std::numeric_limits<std::int32_t>::min();
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            const voxel::Voxel &v = voxels[i];
+            std::int32_t position[3] = {v.positionX, v.positionY, v.positionZ};
+            std::int32_t scale[3] = {v.scaleX, v.scaleY, v.scaleZ};
+            
+            for (int a = 0; a < 3; a++) {
+                min[a] = std::min(min[a], position[a]);
+                max[a] = std::max(max[a], position[a] + scale[a]);
+            }
+        }
+    }
+
+    void occupancyScalar(const std::uint8_t *cells, std::size_t count, std::uint64_t *bits) {
+        for (std::size_t w = 0; w < (count + 63) / 64; w++) {
+            std::uint64_t word = 0;
+            
+            for (std::size_t i = w * 64; i < std::min(count, w * 64 + 64); i++) {
+                word |= std::uint64_t(cells[i] != 0) << (i & 63);
+            }
+            
+            bits[w] = word;
+        }
+    }
+
+#ifdef VOXEL_KERNELS_X86
+    __attribute__((target("sse4.1"))) void decodeXYZISse(const std::uint8_t *xyzi, std::size_t count, const std::int16_t (&offset)[3], voxel::Voxel *voxels) {
+        alignas(16) std::int8_t shuffle[3][16];
+        alignas(16) std::int16_t add[3][8];
+        makeDecodeTables(offset, shuffle, add);
+        
+        __m128i s0 = _mm_load_si128(reinterpret_cast<const __m128i *>(shuffle[0]));
+        __m128i s1 = _mm_load_si128(reinterpret_cast<const __m128i *>(shuffle[1]));
+        __m128i s2 = _mm_load_si128(reinterpret_cast<const __m128i *>(shuffle[2]));
+        __m128i a0 = _mm_load_si128(reinterpret_cast<const __m128i *>(add[0]));
+        __m128i a1 = _mm_load_si128(reinterpret_cast<const __m128i *>(add[1]));
+        __m128i a2 = _mm_load_si128(reinterpret_cast<const __m128i *>(add[2]));
+        std::size_t i = 0;
+        
+        for (; i + 4 <= count; i += 4) {
+            __m128i records = _mm_loadu_si128(reinterpret_cast<const __m128i *>(xyzi + i * 4));
+            __m128i *output = reinterpret_cast<__m128i *>(voxels + i);
+            _mm_storeu_si128(output + 0, _mm_add_epi16(_mm_shuffle_epi8(records, s0), a0));
+            _mm_storeu_si128(output + 1, _mm_add_epi16(_mm_shuffle_epi8(records, s1), a1));
+            _mm_storeu_si128(output + 2, _mm_add_epi16(_mm_shuffle_epi8(records, s2), a2));
+        }
+        
+        decodeXYZIScalar(xyzi + i * 4, count - i, offset, voxels + i);
+    }
+
+    __attribute__((target("avx2"))) void decodeXYZIAvx2(const std::uint8_t *xyzi, std::size_t count, const std::int16_t (&offset)[3], voxel::Voxel *voxels) {
+        alignas(16) std::int8_t shuffle[3][16];
+        alignas(16) std::int16_t add[3][8];
+        makeDecodeTables(offset, shuffle, add);
+        
+        __m256i s0 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(shuffle[0])));
+        __m256i s1 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(shuffle[1])));
+        __m256i s2 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(shuffle[2])));
+        __m256i a0 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(add[0])));
+        __m256i a1 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(add[1])));
+        __m256i a2 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(add[2])));
+        std::size_t i = 0;
+        
+        // shuffle works within 128-bit lanes: every lane makes 48 bytes of its 4 voxels, halves are regrouped on store
+        for (; i + 8 <= count; i += 8) {
+            __m256i records = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(xyzi + i * 4));
+            __m256i r0 = _mm256_add_epi16(_mm256_shuffle_epi8(records, s0), a0);
+            __m256i r1 = _mm256_add_epi16(_mm256_shuffle_epi8(records, s1), a1);
+            __m256i r2 = _mm256_add_epi16(_mm256_shuffle_epi8(records, s2), a2);
+            __m256i *output = reinterpret_cast<__m256i *>(voxels + i);
+            _mm256_storeu_si256(output + 0, _mm256_permute2x128_si256(r0, r1, 0x20));
+            _mm256_storeu_si256(output + 1, _mm256_permute2x128_si256(r2, r0, 0x30));
+            _mm256_storeu_si256(output + 2, _mm256_permute2x128_si256(r1, r2, 0x31));
+        }
+        
+        decodeXYZISse(xyzi + i * 4, count - i, offset, voxels + i);
+    }
+
+    __attribute__((target("sse4.1"))) void reduceBoundsXYZI(__m128i lo, __m128i hi, const std::uint8_t *xyzi, std::size_t tail, std::uint8_t (&min)[3], std::uint8_t (&max)[3]) {
+        alignas(16) std::uint8_t los[16], his[16];
+        _mm_store_si128(reinterpret_cast<__m128i *>(los), lo);
+        _mm_store_si128(reinterpret_cast<__m128i *>(his), hi);
+        boundsXYZIScalar(xyzi, tail, min, max);
+        
+        for (int r = 0; r < 4; r++) {
+            for (int a = 0; a < 3; a++) {
+                min[a] = std::min(min[a], los[r * 4 + a]);
+                max[a] = std::max(max[a], his[r * 4 + a]);
+            }
+        }
+    }
+
+    __attribute__((target("sse4.1"))) void boundsXYZISse(const std::uint8_t *xyzi, std::size_t count, std::uint8_t (&min)[3], std::uint8_t (&max)[3]) {
+        __m128i lo = _mm_set1_epi8(-1), hi = _mm_setzero_si128();
+        std::size_t i = 0;
+        
+        for (; i + 4 <= count; i += 4) {
+            __m128i records = _mm_loadu_si128(reinterpret_cast<const __m128i *>(xyzi + i * 4));
+            lo = _mm_min_epu8(lo, records);
+            hi = _mm_max_epu8(hi, records);
+        }
+        
+        reduceBoundsXYZI(lo, hi, xyzi + i * 4, count - i, min, max);
+    }
+
+    __attribute__((target("avx2"))) void boundsXYZIAvx2(const std::uint8_t *xyzi, std::size_t count, std::uint8_t (&min)[3], std::uint8_t (&max)[3]) {
+        __m256i lo = _mm256_set1_epi8(-1), hi = _mm256_setzero_si256();
+        std::size_t i = 0;
+        
+        for (; i + 8 <= count; i += 8) {
+            __m256i records = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(xyzi + i * 4));
+            lo = _mm256_min_epu8(lo, records);
+            hi = _mm256_max_epu8(hi, records);
+        }
+        
+        __m128i lo128 = _mm_min_epu8(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1));
+        __m128i hi128 = _mm_max_epu8(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1));
+        reduceBoundsXYZI(lo128, hi128, xyzi + i * 4, count - i, min, max);
+    }
+
+    // Lanes of one voxel as int32: position x, y, z, reserved and scale x, y, z, colorIndex. Last lanes are ignored.
+    //
+    __attribute__((target("sse4.1"))) void boundsVoxelsSse(const voxel::Voxel *voxels, std::size_t count, std::int32_t (&min)[3], std::int32_t (&max)[3]) {
+        __m128i lo = _mm_set1_epi32(std::numeric_limits<std::int32_t>::max());
+        __m128i hi = _mm_set1_epi32(std::numeric_limits<std::int32_t>::min());
+        
+        for (std::size_t i = 0; i < count; i++) {
+            std::int32_t scale;
+            std::memcpy(&scale, &voxels[i].scaleX, sizeof(std::int32_t));
+            __m128i position = _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(voxels + i)));
+            lo = _mm_min_epi32(lo, position);
+            hi = _mm_max_epi32(hi, _mm_add_epi32(position, _mm_cvtepu8_epi32(_mm_cvtsi32_si128(scale))));
+        }
+        
+        alignas(16) std::int32_t los[4], his[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(los), lo);
+        _mm_store_si128(reinterpret_cast<__m128i *>(his), hi);
+        
+        for (int a = 0; a < 3; a++) {
+            min[a] = los[a];
+            max[a] = his[a];
+        }
+    }
+
+    __attribute__((target("avx2"))) void boundsVoxelsAvx2(const voxel::Voxel *voxels, std::size_t count, std::int32_t (&min)[3], std::int32_t (&max)[3]) {
+        __m256i lo = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::max());
+        __m256i hi = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::min());
+        std::size_t i = 0;
+        
+        // two voxels per iteration, one in every 128-bit half
+        for (; i + 2 <= count; i += 2) {
+            std::int64_t position0, position1;
+            std::int32_t scale0, scale1;
+            std::memcpy(&position0, voxels + i, sizeof(std::int64_t));
+            std::memcpy(&position1, voxels + i + 1, sizeof(std::int64_t));
+            std::memcpy(&scale0, &voxels[i].scaleX, sizeof(std::int32_t));
+            std::memcpy(&scale1, &voxels[i + 1].scaleX, sizeof(std::int32_t));
+            
+            __m256i position = _mm256_cvtepi16_epi32(_mm_set_epi64x(position1, position0));
+            __m256i scale = _mm256_cvtepu8_epi32(_mm_set_epi32(0, 0, scale1, scale0));
+            lo = _mm256_min_epi32(lo, position);
+            hi = _mm256_max_epi32(hi, _mm256_add_epi32(position, scale));
+        }
+        
+        alignas(32) std::int32_t los[8], his[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(los), lo);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(his), hi);
+        
+        for (int a = 0; a < 3; a++) {
+            min[a] = std::min(los[a], los[4 + a]);
+            max[a] = std::max(his[a], his[4 + a]);
+        }
+        if (i < count) {
+            std::int32_t tailMin[3], tailMax[3];
+            boundsVoxelsScalar(voxels + i, count - i, tailMin, tailMax);
+            
+            for (int a = 0; a < 3; a++) {
+                min[a] = std::min(min[a], tailMin[a]);
+                max[a] = std::max(max[a], tailMax[a]);
+            }
+        }
+    }
+
+    __attribute__((target("sse4.1"))) void occupancySse(const std::uint8_t *cells, std::size_t count, std::uint64_t *bits) {
+        const __m128i zero = _mm_setzero_si128();
+        std::size_t w = 0;
+        
+        for (; w * 64 + 64 <= count; w++) {
+            std::uint64_t word = 0;
+            
+            for (int q = 0; q < 4; q++) {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cells + w * 64 + q * 16));
+                word |= std::uint64_t(~_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero)) & 0xffff) << (q * 16);
+            }
+            
+            bits[w] = word;
+        }
+        
+        occupancyScalar(cells + w * 64, count - w * 64, bits + w);
+    }
+
+    __attribute__((target("avx2"))) void occupancyAvx2(const std::uint8_t *cells, std::size_t count, std::uint64_t *bits) {
+        const __m256i zero = _mm256_setzero_si256();
+        std::size_t w = 0;
+        
+        for (; w * 64 + 64 <= count; w++) {
+            __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells + w * 64));
+            __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells + w * 64 + 32));
+            std::uint32_t emptyLow = std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, zero)));
+            std::uint32_t emptyHigh = std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, zero)));
+            bits[w] = ~(std::uint64_t(emptyHigh) << 32 | emptyLow);
+        }
+        
+        occupancyScalar(cells + w * 64, count - w * 64, bits + w);
+    }
+#endif
+
+    const voxel::VoxelKernels SCALAR_KERNELS = {"scalar", decodeXYZIScalar, boundsXYZIScalar, boundsVoxelsScalar, occupancyScalar};
+
+#ifdef VOXEL_KERNELS_X86
+    const voxel::VoxelKernels SSE_KERNELS = {"sse4.1", decodeXYZISse, boundsXYZISse, boundsVoxelsSse, occupancySse};
+    const voxel::VoxelKernels AVX2_KERNELS = {"avx2", decodeXYZIAvx2, boundsXYZIAvx2, boundsVoxelsAvx2, occupancyAvx2};
+#endif
+
+    const voxel::VoxelKernels &selectKernels() {
+#ifdef VOXEL_KERNELS_X86
+        __builtin_cpu_init();
+        
+        if (__builtin_cpu_supports("avx2")) {
+            return AVX2_KERNELS;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            return SSE_KERNELS;
+        }
+#endif
+        
+        return SCALAR_KERNELS;
+    }
+}
+
+namespace voxel {
+    const VoxelKernels &getVoxelKernels() {
+        static const VoxelKernels &kernels = selectKernels();
+        return kernels;
+    }
+
+    const VoxelKernels &getScalarVoxelKernels() {
+        return SCALAR_KERNELS;
+    }
+}
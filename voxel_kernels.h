@@ -0,0 +1,35 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "voxel_utility.h"
+
+namespace voxel {
+    // Bulk loops of model import. Every kernel has a scalar version and SSE4.1 / AVX2 versions on x86,
+    // the best one supported by CPU is selected on first getVoxelKernels call. All versions give identical results.
+    //
+    struct VoxelKernels {
+        const char *name;
+        
+        // XYZI records (x, y, z, colorIndex + 1 bytes) to unit voxels. Vox axes x, y, z become Z, X, Y:
+        // position is (y + offset[0], z + offset[1], x + offset[2]).
+        void (*decodeXYZI)(const std::uint8_t *xyzi, std::size_t count, const std::int16_t (&offset)[3], Voxel *voxels);
+        
+        // Min and max of x, y, z bytes of XYZI records, @count > 0
+        void (*boundsXYZI)(const std::uint8_t *xyzi, std::size_t count, std::uint8_t (&min)[3], std::uint8_t (&max)[3]);
+        
+        // Cells covered by voxel boxes: min of positions, max of (position + scale) exclusive. @count > 0
+        void (*boundsVoxels)(const Voxel *voxels, std::size_t count, std::int32_t (&min)[3], std::int32_t (&max)[3]);
+        
+        // Bit i of @bits is set if @cells[i] is not zero. Writes (count + 63) / 64 words
+        void (*occupancy)(const std::uint8_t *cells, std::size_t count, std::uint64_t *bits);
+    };
+
+    const VoxelKernels &getVoxelKernels();
+    
+    // Reference versions, getVoxelKernels must give the same results (see voxel_benchmark.cpp)
+    //
+    const VoxelKernels &getScalarVoxelKernels();
+}
@@ -1,11 +1,55 @@
 
 #include "voxel_meshes.h"
 #include "voxel_utility.h"
+#include "voxel_bricks.h"
+#include "voxel_kernels.h"
+#include "voxel_palettes.h"
+#include "thread_pool.h"
+#include "arena.h"
+#include "file_watcher.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <limits>
 #include <unordered_map>
 
 namespace {
     static constexpr uint32_t HALF_CUBE_VERTEX_COUNT = 12;
+    static constexpr uint32_t FACE_VERTEX_COUNT = 4;
+    
+    // Meshes are drawn in batches: voxels of up to MAX_BATCH_MESHES meshes are copied into one instance stream,
+    // Voxel::reserved of every copied voxel is an index in the batch transform table.
+    // Meshes with at least DIRECT_DRAW_VOXEL_COUNT voxels are drawn from their own buffers instead of copying.
+    static constexpr uint32_t MAX_BATCH_MESHES = 32;
+    static constexpr uint32_t MAX_BATCH_VOXELS = 65536;
+    static constexpr uint32_t DIRECT_DRAW_VOXEL_COUNT = 4096;
+    
+    // Work split of updateAndDraw between threads
+    static constexpr std::size_t ANIMATION_PARTITION_SLOTS = 4096;
+    static constexpr std::size_t DRAW_PARTITION_MESHES = 512;
+    
+    // Camera distances of switching to the next coarser level of detail and hysteresis of switching back
+    static constexpr float DEFAULT_LOD_DISTANCES[] = {100.0f, 200.0f, 400.0f};
+    static constexpr float LOD_HYSTERESIS = 0.1f;
+    
+    // Palette row of meshes which follow default palette of VoxelMeshes
+    static constexpr std::uint32_t DEFAULT_PALETTE = std::numeric_limits<std::uint32_t>::max();
+    
+    // Trace recording stops when this count of events is not written out
+    static constexpr std::size_t MAX_TRACE_EVENTS = 1 << 20;
+    
+    static_assert(std::size(DEFAULT_LOD_DISTANCES) == voxel::MAX_LOD_LEVELS, "Every level of detail needs a distance");
+    
+    // Time per updateAndDraw spent on creating GPU data for asynchronously loaded meshes and palettes.
+    // At least one frame is uploaded per call regardless of the budget.
+    static constexpr std::chrono::microseconds ASYNC_UPLOAD_BUDGET = std::chrono::microseconds(2000);
+    
+    // Memory kept by loading arena of every worker thread between loads, larger models free the excess after parsing
+    static constexpr std::size_t LOAD_ARENA_KEPT_BYTES = 16 * 1024 * 1024;
 
     struct VoxelMeshShaderConst {
         math::vector4f axis[3] = {
@@ -30,20 +74,272 @@ namespace {
     }
     _voxelMeshShaderConst;
     
+    struct VoxelMeshShaderBatchConst {
+        math::transform3f transforms[MAX_BATCH_MESHES];
+    };
+    
+    // Face quad of direction d is origin[d] + corner.x * sizeU * axisU[d] + corner.y * sizeV * axisV[d] relative to its min corner cell.
+    // Corners go counter-clockwise seen from outside.
+    //
+    struct VoxelFaceShaderConst {
+        math::vector4f origin[6] = {
+            {0.5f, -0.5f, -0.5f, 0.0f},
+            {-0.5f, -0.5f, -0.5f, 0.0f},
+            {-0.5f, 0.5f, -0.5f, 0.0f},
+            {-0.5f, -0.5f, -0.5f, 0.0f},
+            {-0.5f, -0.5f, 0.5f, 0.0f},
+            {-0.5f, -0.5f, -0.5f, 0.0f},
+        };
+        math::vector4f axisU[6] = {
+            {0.0f, 1.0f, 0.0f, 0.0f},
+            {0.0f, 1.0f, 0.0f, 0.0f},
+            {0.0f, 0.0f, 1.0f, 0.0f},
+            {0.0f, 0.0f, 1.0f, 0.0f},
+            {1.0f, 0.0f, 0.0f, 0.0f},
+            {1.0f, 0.0f, 0.0f, 0.0f},
+        };
+        math::vector4f axisV[6] = {
+            {0.0f, 0.0f, 1.0f, 0.0f},
+            {0.0f, 0.0f, 1.0f, 0.0f},
+            {1.0f, 0.0f, 0.0f, 0.0f},
+            {1.0f, 0.0f, 0.0f, 0.0f},
+            {0.0f, 1.0f, 0.0f, 0.0f},
+            {0.0f, 1.0f, 0.0f, 0.0f},
+        };
+        math::vector4f corner[6 * FACE_VERTEX_COUNT] = {
+            {0.0f, 0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 0.0f},
+            {0.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 0.0f},
+            {0.0f, 0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 0.0f},
+            {0.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 0.0f},
+            {0.0f, 0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 0.0f},
+            {0.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 0.0f},
+        };
+    }
+    _voxelFaceShaderConst;
+    
+    struct VoxelFaceShaderMeshConst {
+        math::transform3f transform;
+    };
+    
+    static_assert(sizeof(math::transform3f) == 16 * sizeof(float), "transform3f is expected to be 4 float4 rows");
+    
+    // Transforms are row-major and applied to row vectors: p' = p.x * row0 + p.y * row1 + p.z * row2 + row3
+    // Shader transforms keep v texcoord of mesh palette row in w of row3 instead of 1.
+    //
+    math::vector3f transformPoint(const math::transform3f &t, const math::vector3f &p) {
+        const float *m = t.flat16;
+        return {
+            p.x * m[0] + p.y * m[4] + p.z * m[8] + m[12],
+            p.x * m[1] + p.y * m[5] + p.z * m[9] + m[13],
+            p.x * m[2] + p.y * m[6] + p.z * m[10] + m[14],
+        };
+    }
+    
+    // Extents of transformed axis-aligned box
+    //
+    math::vector3f transformExtent(const math::transform3f &t, const math::vector3f &e) {
+        const float *m = t.flat16;
+        return {
+            e.x * std::abs(m[0]) + e.y * std::abs(m[4]) + e.z * std::abs(m[8]),
+            e.x * std::abs(m[1]) + e.y * std::abs(m[5]) + e.z * std::abs(m[9]),
+            e.x * std::abs(m[2]) + e.y * std::abs(m[6]) + e.z * std::abs(m[10]),
+        };
+    }
+    
+    // Inverse of rotation-scale part of transform, false if it's degenerate
+    //
+    bool invertBasis(const math::transform3f &t, float (&inverse)[9]) {
+        const float *m = t.flat16;
+        float det = m[0] * (m[5] * m[10] - m[6] * m[9]) - m[1] * (m[4] * m[10] - m[6] * m[8]) + m[2] * (m[4] * m[9] - m[5] * m[8]);
+        
+        if (std::abs(det) < 1e-20f) {
+            return false;
+        }
+        
+        float r = 1.0f / det;
+        inverse[0] = (m[5] * m[10] - m[6] * m[9]) * r;
+        inverse[1] = (m[2] * m[9] - m[1] * m[10]) * r;
+        inverse[2] = (m[1] * m[6] - m[2] * m[5]) * r;
+        inverse[3] = (m[6] * m[8] - m[4] * m[10]) * r;
+        inverse[4] = (m[0] * m[10] - m[2] * m[8]) * r;
+        inverse[5] = (m[2] * m[4] - m[0] * m[6]) * r;
+        inverse[6] = (m[4] * m[9] - m[5] * m[8]) * r;
+        inverse[7] = (m[1] * m[8] - m[0] * m[9]) * r;
+        inverse[8] = (m[0] * m[5] - m[1] * m[4]) * r;
+        return true;
+    }
+    
+    // Steps through cells of size @cellSize crossed by ray origin + direction * t, t in [tMin, tMax), cells in [lo, hi) on every axis.
+    // @visit(cell, tEnter, tExit, axis) gets axis of face the cell is entered through (-1 for the first cell), returns true to stop.
+    //
+    template<typename VISIT> bool traverseCells(const float (&origin)[3], const float (&direction)[3], float tMin, float tMax, int cellSize, const int (&lo)[3], const int (&hi)[3], int axis, VISIT &&visit) {
+        int cell[3], step[3];
+        float tNext[3], tDelta[3];
+        
+        for (int a = 0; a < 3; a++) {
+            float p = origin[a] + direction[a] * tMin;
+            cell[a] = std::min(std::max(int(std::floor(p / float(cellSize))) * cellSize, lo[a]), hi[a] - 1) / cellSize * cellSize;
+            step[a] = direction[a] < 0.0f ? -cellSize : cellSize;
+            tDelta[a] = direction[a] != 0.0f ? float(cellSize) / std::abs(direction[a]) : std::numeric_limits<float>::infinity();
+            tNext[a] = direction[a] != 0.0f ? (float(cell[a] + (step[a] > 0 ? cellSize : 0)) - origin[a]) / direction[a] : std::numeric_limits<float>::infinity();
+        }
+        
+        for (float t = tMin; t < tMax; ) {
+            int next = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+            
+            if (visit(cell, t, std::min(tNext[next], tMax), axis)) {
+                return true;
+            }
+            
+            cell[next] += step[next];
+            
+            if (cell[next] < lo[next] || cell[next] >= hi[next]) {
+                break;
+            }
+            
+            t = tNext[next];
+            tNext[next] += tDelta[next];
+            axis = next;
+        }
+        
+        return false;
+    }
+    
+    // Voxel cells for ray queries kept in sparse palette-compressed bricks, empty bricks are skipped by ray traversal.
+    // Cell is [c - 0.5, c + 0.5) in mesh space.
+    //
+    class PickGrid {
+    public:
+        static constexpr int BRICK_SIZE = voxel::BrickVolume::BRICK_SIZE;
+        
+        PickGrid(const std::vector<voxel::Voxel> &voxels) : _cells(voxel::BrickVolume::fromVoxels(voxels.data(), voxels.size())) {}
+        
+        struct Hit {
+            float distance;
+            int faceAxis; // -1 if ray starts inside voxel
+            int cell[3];
+            std::uint8_t colorIndex;
+        };
+        
+        // First voxel hit by mesh space ray within @maxDistance
+        //
+        bool raycast(const math::vector3f &rayOrigin, const math::vector3f &rayDirection, float maxDistance, Hit &hit) const {
+            const std::int32_t (&min)[3] = _cells.getMin();
+            const std::int32_t (&size)[3] = _cells.getSize();
+            
+            if (_cells.getCellCount() == 0) {
+                return false;
+            }
+            
+            // grid space: cell c is [c, c + 1)
+            float origin[3] = {rayOrigin.x + 0.5f - min[0], rayOrigin.y + 0.5f - min[1], rayOrigin.z + 0.5f - min[2]};
+            float direction[3] = {rayDirection.x, rayDirection.y, rayDirection.z};
+            float tMin = 0.0f, tMax = maxDistance;
+            int entryAxis = -1;
+            
+            for (int a = 0; a < 3; a++) {
+                if (direction[a] != 0.0f) {
+                    float t0 = -origin[a] / direction[a];
+                    float t1 = (float(size[a]) - origin[a]) / direction[a];
+                    
+                    if (std::min(t0, t1) > tMin) {
+                        tMin = std::min(t0, t1);
+                        entryAxis = a;
+                    }
+                    
+                    tMax = std::min(tMax, std::max(t0, t1));
+                }
+                else if (origin[a] < 0.0f || origin[a] >= float(size[a])) {
+                    return false;
+                }
+            }
+            if (tMin >= tMax) {
+                return false;
+            }
+            
+            const int zero[3] = {0, 0, 0};
+            const int brickHi[3] = {
+                (size[0] + BRICK_SIZE - 1) / BRICK_SIZE * BRICK_SIZE,
+                (size[1] + BRICK_SIZE - 1) / BRICK_SIZE * BRICK_SIZE,
+                (size[2] + BRICK_SIZE - 1) / BRICK_SIZE * BRICK_SIZE
+            };
+            
+            return traverseCells(origin, direction, tMin, tMax, BRICK_SIZE, zero, brickHi, entryAxis, [&](const int (&brickCell)[3], float tEnter, float tExit, int brickAxis) {
+                if (_cells.isBrickEmpty(brickCell[0] + min[0], brickCell[1] + min[1], brickCell[2] + min[2])) {
+                    return false;
+                }
+                
+                const int hi[3] = {
+                    std::min(brickCell[0] + BRICK_SIZE, size[0]),
+                    std::min(brickCell[1] + BRICK_SIZE, size[1]),
+                    std::min(brickCell[2] + BRICK_SIZE, size[2])
+                };
+                
+                return traverseCells(origin, direction, tEnter, tExit, 1, brickCell, hi, brickAxis, [&](const int (&cell)[3], float t, float, int axis) {
+                    std::uint8_t colorIndex;
+                    
+                    if (_cells.get(cell[0] + min[0], cell[1] + min[1], cell[2] + min[2], colorIndex)) {
+                        hit = Hit {t, axis, {cell[0] + min[0], cell[1] + min[1], cell[2] + min[2]}, colorIndex};
+                        return true;
+                    }
+                    
+                    return false;
+                });
+            });
+        }
+        
+    private:
+        voxel::BrickVolume _cells;
+    };
+    
     const char *_voxelMeshShader = R"(
         prmnt {
             axis[3] : float4
             cube[12] : float4
         }
+        const {
+            transform[128] : float4
+        }
+        inter {
+            texcoord : float2
+        }
+        vssrc {
+            int slot = int(instance_position.w) * 4;
+            float3 scale = float3(instance_scale_color.xyz);
+            float3 center = instance_position.xyz + 0.5 * (scale - 1.0);
+            float3 position = center.x * transform[slot + 0].xyz + center.y * transform[slot + 1].xyz + center.z * transform[slot + 2].xyz + transform[slot + 3].xyz;
+            float3 toCamera = _cameraPosition.xyz - position;
+            float3 camSign = _sign(float3(_dot(toCamera, transform[slot + 0].xyz), _dot(toCamera, transform[slot + 1].xyz), _dot(toCamera, transform[slot + 2].xyz)));
+            float3 corner = camSign * scale * cube[vertex_ID].xyz;
+            float3 cube_position = corner.x * transform[slot + 0].xyz + corner.y * transform[slot + 1].xyz + corner.z * transform[slot + 2].xyz + position;
+            out_position = _transform(float4(cube_position, 1), _viewProjMatrix);
+            inter.texcoord = float2(float(instance_scale_color.w) / 255.0, transform[slot + 3].w);
+        }
+        fssrc {
+            out_color = _tex2d(0, inter.texcoord);
+        }
+    )";
+    
+    const char *_voxelFaceShader = R"(
+        prmnt {
+            origin[6] : float4
+            axis_u[6] : float4
+            axis_v[6] : float4
+            corner[24] : float4
+        }
+        const {
+            transform[4] : float4
+        }
         inter {
             texcoord : float2
         }
         vssrc {
-            float4 position = float4(instance_position.xyz, 1.0);
-            float3 camSign = _sign(_cameraPosition.xyz - position.xyz);
-            float4 cube_position = float4(camSign, 0.0) * cube[vertex_ID] + position;
-            out_position = _transform(cube_position, _viewProjMatrix);
-            inter.texcoord = float2(float(instance_scale_color.w) / 255.0, 0);
+            int direction = int(instance_position.w);
+            float4 quad = corner[direction * 4 + vertex_ID];
+            float3 local = instance_position.xyz + origin[direction].xyz + quad.x * float(instance_size_color.x) * axis_u[direction].xyz + quad.y * float(instance_size_color.y) * axis_v[direction].xyz;
+            float3 position = local.x * transform[0].xyz + local.y * transform[1].xyz + local.z * transform[2].xyz + transform[3].xyz;
+            out_position = _transform(float4(position, 1), _viewProjMatrix);
+            inter.texcoord = float2(float(instance_size_color.w) / 255.0, transform[3].w);
         }
         fssrc {
             out_color = _tex2d(0, inter.texcoord);
@@ -52,215 +348,1767 @@ namespace {
 }
 
 namespace voxel {
-    class VoxelMeshImp : public VoxelMesh {
+    // Immutable frames and animations shared by all meshes loaded from the same folder
+    //
+    class VoxelMeshResource {
     public:
         struct Frame {
-            std::shared_ptr<platform::StructuredData> voxels;
+            const voxel::Voxel *voxels;
+            std::uint32_t voxelCount;
+            std::shared_ptr<platform::StructuredData> data;
+        };
+        
+        // Frames of one level of detail, level 0 is full model
+        //
+        struct Level {
+            Frame base;
+            std::vector<Frame> frames;
         };
         
         struct Animation {
             std::size_t firstFrame;
             std::size_t lastFrame;
             float frameRate;
+            std::uint32_t index = 0; // of named record in resource, name of playing animation is found by it after reload
         };
         
-        VoxelMeshImp(
-            const std::shared_ptr<platform::Platform> &platform,
-            const std::shared_ptr<platform::RenderingDevice> &renderingDevice,
-            const std::vector<voxel::Frame> &frames,
-            std::unordered_map<std::string, Animation> &&animations
-        )
-        : _platform(platform)
-        , _animations(std::move(animations))
+        // Visible faces of frame with its base, split by direction so turned away ones are not drawn
+        //
+        struct Faces {
+            std::uint32_t faceCount[6] = {};
+            std::shared_ptr<platform::StructuredData> data[6];
+        };
+        
+        // CPU side of resource. Produced by any thread, uploaded on rendering thread.
+        // Voxels are either parsed from model.vox or mapped from model.cooked.
+        //
+        struct Source {
+            std::string path;
+            voxel::Model model;
+            std::shared_ptr<const voxel::CookedModel> cooked;
+            
+            // Names are interned into one string, records are sorted by name (first one wins among equal names)
+            struct NamedAnimation {
+                std::uint32_t nameOffset;
+                std::uint32_t nameLength;
+                Animation animation;
+            };
+            
+            std::string animationNames;
+            std::vector<NamedAnimation> animations;
+            
+            void addAnimation(const std::string &name, const Animation &animation) {
+                animations.emplace_back(NamedAnimation {std::uint32_t(animationNames.size()), std::uint32_t(name.size()), animation});
+                animationNames += name;
+            }
+            
+            void sortAnimations() {
+                std::stable_sort(animations.begin(), animations.end(), [this](const NamedAnimation &a, const NamedAnimation &b) {
+                    return animationNames.compare(a.nameOffset, a.nameLength, animationNames, b.nameOffset, b.nameLength) < 0;
+                });
+                
+                for (std::size_t i = 0; i < animations.size(); i++) {
+                    animations[i].animation.index = std::uint32_t(i);
+                }
+            }
+            
+            const Animation *findAnimation(const char *name) const {
+                auto index = std::lower_bound(animations.begin(), animations.end(), name, [this](const NamedAnimation &a, const char *name) {
+                    return animationNames.compare(a.nameOffset, a.nameLength, name) < 0;
+                });
+                
+                if (index != animations.end() && animationNames.compare(index->nameOffset, index->nameLength, name) == 0) {
+                    return &index->animation;
+                }
+                
+                return nullptr;
+            }
+            
+            std::string getAnimationName(const Animation &animation) const {
+                const NamedAnimation &named = animations[animation.index];
+                return animationNames.substr(named.nameOffset, named.nameLength);
+            }
+            
+            std::size_t getLevelCount() const {
+                return cooked ? cooked->getLevelCount() : model.lods.size() + 1;
+            }
+            
+            // RGBA chunk of model.vox, nullptr if absent
+            const std::uint8_t *getPalette() const {
+                return cooked ? cooked->getPalette() : model.palette.size() ? model.palette.data() : nullptr;
+            }
+            
+            std::size_t getFrameCount() const {
+                return cooked ? cooked->getFrameCount() : model.frames.size();
+            }
+            
+            const voxel::Voxel *getFrameVoxels(std::size_t level, std::size_t index, std::uint32_t &voxelCount) const {
+                if (cooked) {
+                    return cooked->getFrameVoxels(std::uint32_t(level), std::uint32_t(index), voxelCount);
+                }
+                
+                const voxel::Frame &frame = level ? model.lods[level - 1].frames[index] : model.frames[index];
+                voxelCount = std::uint32_t(frame.voxels.size());
+                return frame.voxels.data();
+            }
+            
+            const voxel::Voxel *getBaseVoxels(std::size_t level, std::uint32_t &voxelCount) const {
+                if (cooked) {
+                    return cooked->getBaseVoxels(std::uint32_t(level), voxelCount);
+                }
+                
+                const voxel::Frame &base = level ? model.lods[level - 1].base : model.base;
+                voxelCount = std::uint32_t(base.voxels.size());
+                return base.voxels.data();
+            }
+        };
+        
+        // Frames point to voxels of source, so it's kept alive by resource.
+        // @paletteRow is row of embedded palette in palette atlas or DEFAULT_PALETTE.
+        //
+        VoxelMeshResource(const std::shared_ptr<Source> &source, std::vector<Level> &&levels, std::uint32_t paletteRow)
+        : _source(source)
+        , _levels(std::move(levels))
+        , _paletteRow(paletteRow)
         {
-            _frames.reserve(frames.size());
+            math::vector3f boundsMin (std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+            math::vector3f boundsMax (-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+            
+            auto addFrame = [&](const Frame &frame) {
+                std::int32_t min[3], max[3];
+                
+                if (frame.voxelCount) {
+                    voxel::getVoxelKernels().boundsVoxels(frame.voxels, frame.voxelCount, min, max);
+                    boundsMin = math::vector3f(std::min(boundsMin.x, min[0] - 0.5f), std::min(boundsMin.y, min[1] - 0.5f), std::min(boundsMin.z, min[2] - 0.5f));
+                    boundsMax = math::vector3f(std::max(boundsMax.x, max[0] - 0.5f), std::max(boundsMax.y, max[1] - 0.5f), std::max(boundsMax.z, max[2] - 0.5f));
+                }
+            };
+            
+            for (auto &level : _levels) {
+                addFrame(level.base);
+                
+                for (auto &frame : level.frames) {
+                    addFrame(frame);
+                }
+            }
             
-            for (auto &frame : frames) {
-                _frames.emplace_back(Frame {renderingDevice->createData(&frame.voxels[0], uint32_t(frame.voxels.size()), sizeof(voxel::Voxel))});
+            if (boundsMin.x <= boundsMax.x) {
+                _boundsCenter = (boundsMin + boundsMax) * 0.5f;
+                _boundsExtent = (boundsMax - boundsMin) * 0.5f;
             }
         }
         
-        ~VoxelMeshImp() {
+        static Frame uploadFrame(const std::shared_ptr<platform::RenderingDevice> &renderingDevice, const Source &source, std::size_t level, std::size_t index) {
+            std::uint32_t voxelCount = 0;
+            const voxel::Voxel *voxels = source.getFrameVoxels(level, index, voxelCount);
+            return _upload(renderingDevice, voxels, voxelCount);
+        }
         
+        static Frame uploadBase(const std::shared_ptr<platform::RenderingDevice> &renderingDevice, const Source &source, std::size_t level) {
+            std::uint32_t voxelCount = 0;
+            const voxel::Voxel *voxels = source.getBaseVoxels(level, voxelCount);
+            return _upload(renderingDevice, voxels, voxelCount);
         }
         
-        void setTransform(const math::transform3f &fullTransform) {
-            _transform = fullTransform;
+        static Level uploadLevel(const std::shared_ptr<platform::RenderingDevice> &renderingDevice, const Source &source, std::size_t level) {
+            Level result;
+            result.base = uploadBase(renderingDevice, source, level);
+            result.frames.reserve(source.getFrameCount());
+            
+            for (std::size_t i = 0; i < source.getFrameCount(); i++) {
+                result.frames.emplace_back(uploadFrame(renderingDevice, source, level, i));
+            }
+            
+            return result;
+        }
+        
+        const Animation *getAnimation(const char *name) const {
+            return _source->findAnimation(name);
+        }
+        
+        std::string getAnimationName(const Animation &animation) const {
+            return _source->getAnimationName(animation);
+        }
+        
+        const Frame &getFrame(std::size_t level, std::size_t index) const {
+            return _levels[level].frames[index];
+        }
+        
+        // Voxels drawn with every frame, empty unless delta frames are used
+        //
+        const Frame &getBase(std::size_t level) const {
+            return _levels[level].base;
         }
         
-        void playAnimation(const char *name, std::function<void(VoxelMesh&)> &&finished) {
-            auto index = _animations.find(name);
-            if (index != _animations.end()) {
-                _currentAnimation = &index->second;
-                _currentFrame = _currentAnimation->firstFrame;
-                _time = 0.0f;
-                _lastFrame = 0;
-                _finished = std::move(finished);
+        std::size_t getLevelCount() const {
+            return _levels.size();
+        }
+        
+        std::size_t getFrameCount() const {
+            return _levels[0].frames.size();
+        }
+        
+        // Box covering all frames of all levels in mesh space
+        //
+        const math::vector3f &getBoundsCenter() const {
+            return _boundsCenter;
+        }
+        
+        const math::vector3f &getBoundsExtent() const {
+            return _boundsExtent;
+        }
+        
+        // Full detail voxels of frame for ray queries. Built on first request, rendering thread only.
+        //
+        const PickGrid &getPickGrid(std::size_t index) const {
+            if (_pickGrids.empty()) {
+                _pickGrids.resize(getFrameCount());
             }
-            else {
-                _currentAnimation = nullptr;
+            if (_pickGrids[index] == nullptr) {
+                const Frame &base = _levels[0].base;
+                const Frame &frame = _levels[0].frames[index];
+                std::vector<voxel::Voxel> voxels (base.voxels, base.voxels + base.voxelCount);
+                voxels.insert(voxels.end(), frame.voxels, frame.voxels + frame.voxelCount);
+                _pickGrids[index] = std::make_unique<PickGrid>(voxels);
             }
+            
+            return *_pickGrids[index];
         }
         
-        void updateAnimation(float dtSec) {
-            if (_currentAnimation) {
-                std::size_t frame = std::size_t(_time * _currentAnimation->frameRate);
+        // Builds and uploads faces of all levels and frames on the first call, rendering thread only
+        //
+        void prepareFaces(const std::shared_ptr<platform::Platform> &platform, const std::shared_ptr<platform::RenderingDevice> &renderingDevice) const {
+            if (_faces.size()) {
+                return;
+            }
+            
+            std::vector<voxel::Voxel> voxels;
+            std::vector<voxel::Face> faces;
+            std::size_t voxelCount = 0, faceCount = 0;
+            
+            _faces.resize(_levels.size());
+            
+            for (std::size_t level = 0; level < _levels.size(); level++) {
+                const Frame &base = _levels[level].base;
+                _faces[level].resize(_levels[level].frames.size());
                 
-                if (frame != _lastFrame) {
-                    if (_currentFrame == _currentAnimation->lastFrame) {
-                        _currentFrame = _currentAnimation->firstFrame;
+                for (std::size_t i = 0; i < _levels[level].frames.size(); i++) {
+                    const Frame &frame = _levels[level].frames[i];
+                    voxels.assign(base.voxels, base.voxels + base.voxelCount);
+                    voxels.insert(voxels.end(), frame.voxels, frame.voxels + frame.voxelCount);
+                    faces.clear();
+                    voxel::buildFaces(voxels.data(), voxels.size(), faces);
+                    
+                    for (std::size_t start = 0, end = 0; start < faces.size(); start = end) {
+                        std::int16_t direction = faces[start].direction;
                         
-                        if (_finished) {
-                            _finished(*this);
-                        };
+                        while (end < faces.size() && faces[end].direction == direction) {
+                            end++;
+                        }
                         
-                        _currentAnimation = nullptr;
-                        //_time -= float(_currentAnimation->lastFrame - _currentAnimation->firstFrame + 1) / _currentAnimation->frameRate;
-                        //frame = std::size_t(_time * _currentAnimation->frameRate);
+                        _faces[level][i].faceCount[direction] = std::uint32_t(end - start);
+                        _faces[level][i].data[direction] = renderingDevice->createData(&faces[start], std::uint32_t(end - start), sizeof(voxel::Face));
+                        _faceBytes += (end - start) * sizeof(voxel::Face);
                     }
-                    else {
-                        _currentFrame++;
+                    if (level == 0) {
+                        voxelCount += voxels.size();
+                        faceCount += faces.size();
                     }
-                    
-                    _lastFrame = frame;
                 }
-                
-                _time += dtSec;
-            }
-            else {
-                _currentFrame = 0;
             }
+            
+            platform->logMsg("[VoxelMeshes] Faces of '%s': %d quads (%d vertices) for %d voxels (%d vertices) in %d frames",
+                _source->path.data(), int(faceCount), int(faceCount * FACE_VERTEX_COUNT), int(voxelCount), int(voxelCount * HALF_CUBE_VERTEX_COUNT), int(getFrameCount()));
+        }
+        
+        // Valid after prepareFaces
+        //
+        const Faces &getFaces(std::size_t level, std::size_t index) const {
+            return _faces[level][index];
         }
         
-        const std::shared_ptr<platform::StructuredData> &getVoxelData() const {
-            return _frames[_currentFrame].voxels;
+        std::uint32_t getPaletteRow() const {
+            return _paletteRow;
         }
         
-        std::uint32_t getVoxelCount() const {
-            return _frames[_currentFrame].voxels->getCount();
+        std::size_t getVoxelBytes() const {
+            std::size_t result = _faceBytes;
+            
+            for (auto &level : _levels) {
+                result += level.base.voxelCount * sizeof(voxel::Voxel);
+                
+                for (auto &frame : level.frames) {
+                    result += frame.voxelCount * sizeof(voxel::Voxel);
+                }
+            }
+            
+            return result;
         }
         
     private:
-        std::shared_ptr<platform::Platform> _platform;
-        Animation *_currentAnimation = nullptr;
-
-        std::function<void(VoxelMesh&)> _finished;
-        std::unordered_map<std::string, Animation> _animations;
-        std::vector<Frame> _frames;
-
-        math::transform3f _transform = math::transform3f::identity();
-        float _time = 0.0f;
+        std::shared_ptr<const Source> _source;
+        std::vector<Level> _levels;
+        std::uint32_t _paletteRow;
+        mutable std::vector<std::unique_ptr<PickGrid>> _pickGrids;
+        mutable std::vector<std::vector<Faces>> _faces;
+        mutable std::size_t _faceBytes = 0;
+        math::vector3f _boundsCenter = {0, 0, 0};
+        math::vector3f _boundsExtent = {0, 0, 0};
         
-        std::size_t _lastFrame = 0;
-        std::size_t _currentFrame = 0;
+        // empty frames have no GPU data
+        static Frame _upload(const std::shared_ptr<platform::RenderingDevice> &renderingDevice, const voxel::Voxel *voxels, std::uint32_t voxelCount) {
+            return Frame {voxels, voxelCount, voxelCount ? renderingDevice->createData(voxels, voxelCount, sizeof(voxel::Voxel)) : nullptr};
+        }
     };
-
-    void VoxelMesh::setTransform(const math::transform3f &fullTransform) {
-        static_cast<VoxelMeshImp *>(this)->setTransform(fullTransform);
-    }
-
-    void VoxelMesh::playAnimation(const char *name, std::function<void(VoxelMesh&)> &&finished) {
-        static_cast<VoxelMeshImp *>(this)->playAnimation(name, std::move(finished));
-    }
-
-    class VoxelMeshesImp : public VoxelMeshes {
+    
+    class VoxelMeshImp;
+    
+    // Animation clocks of all meshes in structure-of-arrays layout, advanced together by update.
+    // Current frame is computed from time elapsed since animation start, so any number of frames may be skipped.
+    // Slots are kept dense: removed slot is replaced by the last one.
+    //
+    class AnimationPool {
     public:
-        VoxelMeshesImp(
-            const std::shared_ptr<platform::Platform> &platform,
-            const std::shared_ptr<platform::RenderingDevice> &renderingDevice,
-            const std::shared_ptr<platform::Texture2D> &palette
-        ) {
-            _platform = platform;
-            _renderingDevice = renderingDevice;
-            _palette = palette;
-            
-            _shader = renderingDevice->createShader(
-                _voxelMeshShader,
-                {{"ID", platform::ShaderInput::Format::VERTEX_ID}},
-                {
-                    {"position", platform::ShaderInput::Format::SHORT4},
-                    {"scale_color", platform::ShaderInput::Format::BYTE4}
-                },
-                &_voxelMeshShaderConst
-            );
+        using Playback = VoxelMesh::Playback;
+        
+        struct Playing {
+            VoxelMeshResource::Animation animation;
+            Playback playback;
+            float speed;
+            std::function<void(VoxelMesh&)> finished;
+        };
+        
+        std::uint32_t add(VoxelMeshImp *owner) {
+            _owners.emplace_back(owner);
+            _finished.emplace_back();
+            _queues.emplace_back();
+            _animations.emplace_back();
+            _times.emplace_back(0.0f);
+            _endTimes.emplace_back(0.0f);
+            _speeds.emplace_back(0.0f);
+            _frameRates.emplace_back(0.0f);
+            _firstFrames.emplace_back(0);
+            _frameCounts.emplace_back(1);
+            _currentFrames.emplace_back(0);
+            _playbacks.emplace_back(std::uint8_t(Playback::ONCE));
+            _playing.emplace_back(0);
+            return std::uint32_t(_owners.size() - 1);
         }
         
-        ~VoxelMeshesImp() {
+        void remove(std::uint32_t slot);
         
+        // Replaces current animation and queue, callbacks of replaced animations are not called
+        //
+        void play(std::uint32_t slot, Playing &&playing) {
+            _queues[slot].clear();
+            _start(slot, std::move(playing), 0.0f);
+            _currentFrames[slot] = _frame(slot);
         }
-
-        std::shared_ptr<VoxelMesh> loadMesh(const char *fullFolderPath) {
-            std::string infoPath = std::string(fullFolderPath) + "/model.info";
-            std::string modelPath = std::string(fullFolderPath) + "/model.vox";
-            std::vector<voxel::Frame> frames = voxel::loadModel(_platform, modelPath.data(), {0, 0, 0});
-            std::unordered_map<std::string, VoxelMeshImp::Animation> animations;
-            
-            if (frames.size()) {
-                std::unique_ptr<uint8_t []> infoData;
-                std::size_t infoSize;
-                
-                if (_platform->loadFile(infoPath.data(), infoData, infoSize)) {
-                    std::istringstream stream (std::string(reinterpret_cast<const char *>(infoData.get()), infoSize));
-                    std::string keyword;
-                    
-                    while (stream >> keyword) {
-                        if (keyword == "animation") {
-                            std::string animationName;
-                            std::size_t firstFrame, lastFrame;
-                            float frameRate;
-                            
-                            if (stream >> utility::expect<'='> >> utility::quoted(animationName) >> firstFrame >> lastFrame >> frameRate) {
-                                animations.emplace(std::move(animationName), VoxelMeshImp::Animation {firstFrame, lastFrame, frameRate});
-                            }
-                            else {
-                                _platform->logError("[VoxelMeshes] Invalid animation '%s' arguments in '%s'", animationName.data(), infoPath.data());
-                                break;
-                            }
-                        }
-                        else {
-                            _platform->logError("[VoxelMeshes] Unreconized keyword '%s' in '%s'", keyword.data(), infoPath.data());
-                            break;
-                        }
-                    }
+        
+        // Current animation ends at its end (looping one at the end of its cycle), then queued ones are played in order
+        //
+        void queue(std::uint32_t slot, Playing &&playing) {
+            if (_playing[slot]) {
+                _queues[slot].emplace_back(std::move(playing));
+            }
+            else {
+                play(slot, std::move(playing));
+            }
+        }
+        
+        // Maps current and queued animations of slot to animations of reloaded resource by @remap, which returns false
+        // for animations which don't exist anymore. Elapsed time is kept, so animation continues from the same point.
+        // Unmapped current animation is stopped with its queue, unmapped queued ones are dropped. Callbacks are not called.
+        //
+        void remap(std::uint32_t slot, const std::function<bool(VoxelMeshResource::Animation &)> &mapping) {
+            if (_playing[slot]) {
+                VoxelMeshResource::Animation animation = _animations[slot];
+                
+                if (mapping(animation)) {
+                    _setAnimation(slot, animation, Playback(_playbacks[slot]));
+                }
+                else {
+                    _finished[slot] = nullptr;
+                    _queues[slot].clear();
+                    _playing[slot] = 0;
                 }
-
-                _meshes.emplace_back(std::make_shared<VoxelMeshImp>(_platform, _renderingDevice, frames, std::move(animations)));
-                return _meshes.back();
             }
-
-            return nullptr;
+            
+            std::deque<Playing> &queue = _queues[slot];
+            queue.erase(std::remove_if(queue.begin(), queue.end(), [&](Playing &playing) {
+                return mapping(playing.animation) == false;
+            }), queue.end());
+            
+            _currentFrames[slot] = _frame(slot);
         }
         
-        void updateAndDraw(float dtSec) {
-            _renderingDevice->applyTextures({_palette.get()});
-            _renderingDevice->applyShader(_shader);
+        std::size_t getCurrentFrame(std::uint32_t slot) const {
+            return _currentFrames[slot];
+        }
+        
+        std::size_t getSlotCount() const {
+            return _owners.size();
+        }
+        
+        // Animations finished by update, in slot order
+        //
+        struct Finished {
+            std::vector<VoxelMeshImp *> meshes;
+            std::vector<std::function<void(VoxelMesh&)>> callbacks;
+        };
+        
+        // Advances slots [begin, end). Disjoint ranges may be updated from different threads.
+        // Returns count of meshes which have current frame changed.
+        // Callbacks of finished animations are not called here, see dispatchFinished.
+        //
+        std::uint32_t update(std::size_t begin, std::size_t end, float dtSec, Finished &finished) {
+            std::uint32_t switches = 0;
             
-            for (auto &mesh : _meshes) {
-                mesh->updateAnimation(dtSec);
-                _renderingDevice->drawGeometry(nullptr, mesh->getVoxelData(), HALF_CUBE_VERTEX_COUNT, mesh->getVoxelCount(), platform::Topology::TRIANGLESTRIP);
+            for (std::size_t i = begin; i < end; i++) {
+                _times[i] += _playing[i] ? dtSec * _speeds[i] : 0.0f;
+                
+                if (_times[i] >= _endTimes[i]) {
+                    _finish(i, finished);
+                }
+                
+                std::uint32_t frame = _frame(i);
+                switches += std::uint32_t(frame != _currentFrames[i]);
+                _currentFrames[i] = frame;
             }
+            
+            return switches;
         }
         
-        std::shared_ptr<platform::Platform> _platform;
-        std::shared_ptr<platform::RenderingDevice> _renderingDevice;
-        std::shared_ptr<platform::Shader> _shader;
-        std::vector<std::shared_ptr<VoxelMeshImp>> _meshes;
-        std::shared_ptr<platform::Texture2D> _palette;
+        // Calls and clears callbacks of animations finished by update. Must be called on rendering thread, not during update.
+        // Callbacks may play animations and add or remove meshes,
+        // but owners of finished animations must be alive (VoxelMeshesImp holds all meshes during update).
+        //
+        void dispatchFinished(Finished &finished);
+        
+    private:
+        // cold
+        std::vector<VoxelMeshImp *> _owners;
+        std::vector<std::function<void(VoxelMesh&)>> _finished;
+        std::vector<std::deque<Playing>> _queues;
+        std::vector<VoxelMeshResource::Animation> _animations;
+        
+        // hot, touched by every update. Time is in animation seconds (real ones multiplied by speed)
+        std::vector<float> _times;
+        std::vector<float> _endTimes;
+        std::vector<float> _speeds;
+        std::vector<float> _frameRates;
+        std::vector<std::uint32_t> _firstFrames;
+        std::vector<std::uint32_t> _frameCounts;
+        std::vector<std::uint32_t> _currentFrames;
+        std::vector<std::uint8_t> _playbacks;
+        std::vector<std::uint8_t> _playing;
+        
+        // Frame 0 is shown when nothing is playing
+        //
+        std::uint32_t _frame(std::size_t i) const {
+            std::uint32_t count = _frameCounts[i];
+            std::uint32_t tick = std::uint32_t(std::min(_times[i] * _frameRates[i], float(std::numeric_limits<std::int32_t>::max())));
+            std::uint32_t phase = std::min(tick, count - 1);
+            
+            if (_playbacks[i] == std::uint8_t(Playback::LOOP)) {
+                phase = tick % count;
+            }
+            else if (_playbacks[i] == std::uint8_t(Playback::PING_PONG) && count > 1) {
+                std::uint32_t period = 2 * count - 2;
+                phase = tick % period < count ? tick % period : period - tick % period;
+            }
+            
+            return _playing[i] ? _firstFrames[i] + phase : 0;
+        }
+        
+        // @time is already elapsed part of animation in real seconds
+        //
+        void _start(std::size_t i, Playing &&playing, float time) {
+            _finished[i] = std::move(playing.finished);
+            _speeds[i] = std::max(playing.speed, 0.0f);
+            _times[i] = time * _speeds[i];
+            _setAnimation(i, playing.animation, playing.playback);
+            _playing[i] = 1;
+        }
+        
+        void _setAnimation(std::size_t i, const VoxelMeshResource::Animation &animation, Playback playback) {
+            std::uint32_t count = animation.lastFrame >= animation.firstFrame ? std::uint32_t(animation.lastFrame - animation.firstFrame + 1) : 1;
+            std::uint32_t cycleFrames = playback == Playback::PING_PONG && count > 1 ? 2 * count - 2 : count;
+            
+            _animations[i] = animation;
+            _frameRates[i] = animation.frameRate;
+            _endTimes[i] = animation.frameRate > 0.0f ? float(cycleFrames) / animation.frameRate : std::numeric_limits<float>::infinity();
+            _firstFrames[i] = std::uint32_t(animation.firstFrame);
+            _frameCounts[i] = count;
+            _playbacks[i] = std::uint8_t(playback);
+        }
+        
+        // Called when time reaches end of animation or end of looping cycle.
+        // Leftover time goes to queued animations, so several of them may finish in one update.
+        //
+        void _finish(std::size_t i, Finished &finished) {
+            while (_playing[i] && _times[i] >= _endTimes[i]) {
+                if (_playbacks[i] != std::uint8_t(Playback::ONCE) && _queues[i].empty()) {
+                    _times[i] = std::fmod(_times[i], _endTimes[i]);
+                    break;
+                }
+                
+                float leftover = _speeds[i] > 0.0f ? (_times[i] - _endTimes[i]) / _speeds[i] : 0.0f;
+                
+                if (_finished[i]) {
+                    finished.meshes.emplace_back(_owners[i]);
+                    finished.callbacks.emplace_back(std::move(_finished[i]));
+                    _finished[i] = nullptr;
+                }
+                if (_queues[i].empty()) {
+                    _playing[i] = 0;
+                    break;
+                }
+                
+                Playing next = std::move(_queues[i].front());
+                _queues[i].pop_front();
+                _start(i, std::move(next), leftover);
+            }
+        }
+    };
+    
+    class VoxelMeshImp : public VoxelMesh {
+    public:
+        VoxelMeshImp(const std::shared_ptr<platform::Platform> &platform, const std::shared_ptr<AnimationPool> &animations, const std::shared_ptr<const VoxelMeshResource> &resource)
+        : _platform(platform)
+        , _animations(animations)
+        , _resource(resource)
+        , _paletteRow(resource->getPaletteRow())
+        {
+            _slot = _animations->add(this);
+        }
+        
+        ~VoxelMeshImp() {
+            _animations->remove(_slot);
+        }
+        
+        void setTransform(const math::transform3f &fullTransform) {
+            _transform = fullTransform;
+        }
+        
+        void setRenderMode(RenderMode mode) {
+            _renderMode = mode;
+        }
+        
+        RenderMode getRenderMode() const {
+            return _renderMode;
+        }
+        
+        void setPalette(std::uint32_t row) {
+            _paletteRow = row;
+        }
+        
+        std::uint32_t getPaletteRow() const {
+            return _paletteRow;
+        }
+        
+        void playAnimation(const char *name, Playback playback, float speed, std::function<void(VoxelMesh&)> &&finished) {
+            if (const VoxelMeshResource::Animation *animation = _resource->getAnimation(name)) {
+                _animations->play(_slot, AnimationPool::Playing {*animation, playback, speed, std::move(finished)});
+            }
+        }
+        
+        void queueAnimation(const char *name, Playback playback, float speed, std::function<void(VoxelMesh&)> &&finished) {
+            if (const VoxelMeshResource::Animation *animation = _resource->getAnimation(name)) {
+                _animations->queue(_slot, AnimationPool::Playing {*animation, playback, speed, std::move(finished)});
+            }
+        }
+        
+        // Switches mesh to reloaded resource. Transform and render mode are kept, animations are mapped by name.
+        // Mesh with palette embedded into previous resource takes embedded palette of the new one.
+        //
+        void setResource(const std::shared_ptr<const VoxelMeshResource> &resource) {
+            const VoxelMeshResource &previous = *_resource;
+            
+            _animations->remap(_slot, [&](VoxelMeshResource::Animation &animation) {
+                const VoxelMeshResource::Animation *next = resource->getAnimation(previous.getAnimationName(animation).data());
+                
+                if (next) {
+                    animation = *next;
+                    return true;
+                }
+                
+                return false;
+            });
+            
+            _paletteRow = _paletteRow == previous.getPaletteRow() ? resource->getPaletteRow() : _paletteRow;
+            _lod = std::min(_lod, resource->getLevelCount() - 1);
+            _resource = resource;
+        }
+        
+        // Coarser level is taken beyond its distance, finer one is taken back only after coming LOD_HYSTERESIS closer.
+        // @lodDistances[i] is distance of switching from level i to level i + 1.
+        //
+        void updateLod(float distance, const std::vector<float> &lodDistances) {
+            std::size_t levelCount = std::min(_resource->getLevelCount(), lodDistances.size() + 1);
+            
+            while (_lod + 1 < levelCount && distance > lodDistances[_lod]) {
+                _lod++;
+            }
+            while (_lod > 0 && (_lod >= levelCount || distance < lodDistances[_lod - 1] * (1.0f - LOD_HYSTERESIS))) {
+                _lod--;
+            }
+        }
+        
+        const math::transform3f &getTransform() const {
+            return _transform;
+        }
+        
+        std::size_t getFrameIndex() const {
+            return _animations->getCurrentFrame(_slot);
+        }
+        
+        const VoxelMeshResource::Frame &getFrame() const {
+            return _resource->getFrame(_lod, getFrameIndex());
+        }
+        
+        const VoxelMeshResource::Frame &getBase() const {
+            return _resource->getBase(_lod);
+        }
+        
+        const VoxelMeshResource::Faces &getFaces() const {
+            return _resource->getFaces(_lod, getFrameIndex());
+        }
+        
+        const VoxelMeshResource &getResource() const {
+            return *_resource;
+        }
+        
+    private:
+        friend class AnimationPool;
+        
+        std::shared_ptr<platform::Platform> _platform;
+        std::shared_ptr<AnimationPool> _animations;
+        std::shared_ptr<const VoxelMeshResource> _resource;
+        std::uint32_t _slot = 0;
+
+        math::transform3f _transform = math::transform3f::identity();
+        std::size_t _lod = 0;
+        RenderMode _renderMode = RenderMode::VOXELS;
+        std::uint32_t _paletteRow;
+    };
+    
+    void AnimationPool::remove(std::uint32_t slot) {
+        std::uint32_t last = std::uint32_t(_owners.size() - 1);
+        
+        if (slot != last) {
+            _owners[slot] = _owners[last];
+            _owners[slot]->_slot = slot;
+            _finished[slot] = std::move(_finished[last]);
+            _queues[slot] = std::move(_queues[last]);
+            _animations[slot] = _animations[last];
+            _times[slot] = _times[last];
+            _endTimes[slot] = _endTimes[last];
+            _speeds[slot] = _speeds[last];
+            _frameRates[slot] = _frameRates[last];
+            _firstFrames[slot] = _firstFrames[last];
+            _frameCounts[slot] = _frameCounts[last];
+            _currentFrames[slot] = _currentFrames[last];
+            _playbacks[slot] = _playbacks[last];
+            _playing[slot] = _playing[last];
+        }
+        
+        _owners.pop_back();
+        _finished.pop_back();
+        _queues.pop_back();
+        _animations.pop_back();
+        _times.pop_back();
+        _endTimes.pop_back();
+        _speeds.pop_back();
+        _frameRates.pop_back();
+        _firstFrames.pop_back();
+        _frameCounts.pop_back();
+        _currentFrames.pop_back();
+        _playbacks.pop_back();
+        _playing.pop_back();
+    }
+    
+    void AnimationPool::dispatchFinished(Finished &finished) {
+        for (std::size_t i = 0; i < finished.meshes.size(); i++) {
+            if (finished.callbacks[i]) {
+                finished.callbacks[i](*finished.meshes[i]);
+            }
+        }
+        
+        finished.meshes.clear();
+        finished.callbacks.clear();
+    }
+
+    void VoxelMesh::setTransform(const math::transform3f &fullTransform) {
+        static_cast<VoxelMeshImp *>(this)->setTransform(fullTransform);
+    }
+
+    void VoxelMesh::setRenderMode(RenderMode mode) {
+        static_cast<VoxelMeshImp *>(this)->setRenderMode(mode);
+    }
+
+    void VoxelMesh::setPalette(std::uint32_t row) {
+        static_cast<VoxelMeshImp *>(this)->setPalette(row);
+    }
+
+    void VoxelMesh::playAnimation(const char *name, std::function<void(VoxelMesh&)> &&finished) {
+        static_cast<VoxelMeshImp *>(this)->playAnimation(name, Playback::ONCE, 1.0f, std::move(finished));
+    }
+
+    void VoxelMesh::playAnimation(const char *name, Playback playback, float speed, std::function<void(VoxelMesh&)> &&finished) {
+        static_cast<VoxelMeshImp *>(this)->playAnimation(name, playback, speed, std::move(finished));
+    }
+
+    void VoxelMesh::queueAnimation(const char *name, Playback playback, float speed, std::function<void(VoxelMesh&)> &&finished) {
+        static_cast<VoxelMeshImp *>(this)->queueAnimation(name, playback, speed, std::move(finished));
+    }
+
+    std::size_t VoxelMesh::getGpuBytes() const {
+        return static_cast<const VoxelMeshImp *>(this)->getResource().getVoxelBytes();
+    }
+
+    class VoxelMeshesImp : public VoxelMeshes {
+    public:
+        VoxelMeshesImp(
+            const std::shared_ptr<platform::Platform> &platform,
+            const std::shared_ptr<platform::RenderingDevice> &renderingDevice,
+            const std::shared_ptr<Camera> &camera,
+            const std::vector<std::uint8_t> &palette
+        )
+        : _palettes(renderingDevice)
+        {
+            _platform = platform;
+            _renderingDevice = renderingDevice;
+            _camera = camera;
+            
+            std::vector<std::uint8_t> white (PaletteAtlas::PALETTE_BYTES, 0xff);
+            _palettes.add(palette.size() == PaletteAtlas::PALETTE_BYTES ? palette.data() : white.data(), _defaultPalette);
+            
+            _shader = renderingDevice->createShader(
+                _voxelMeshShader,
+                {{"ID", platform::ShaderInput::Format::VERTEX_ID}},
+                {
+                    {"position", platform::ShaderInput::Format::SHORT4},
+                    {"scale_color", platform::ShaderInput::Format::BYTE4}
+                },
+                &_voxelMeshShaderConst
+            );
+            _faceShader = renderingDevice->createShader(
+                _voxelFaceShader,
+                {{"ID", platform::ShaderInput::Format::VERTEX_ID}},
+                {
+                    {"position", platform::ShaderInput::Format::SHORT4},
+                    {"size_color", platform::ShaderInput::Format::BYTE4}
+                },
+                &_voxelFaceShaderConst
+            );
+        }
+        
+        ~VoxelMeshesImp() {
+        
+        }
+
+        // Asynchronous loading of the same folder in progress is finished here instead of parsing the folder again
+        //
+        std::shared_ptr<VoxelMesh> loadMesh(const char *fullFolderPath) {
+            std::shared_ptr<const VoxelMeshResource> resource;
+            auto cached = _resources.find(fullFolderPath);
+            auto loading = _meshLoadings.find(fullFolderPath);
+            
+            if (cached != _resources.end()) {
+                if ((resource = cached->second.lock()) == nullptr) {
+                    _resources.erase(cached);
+                }
+            }
+            if (resource == nullptr && loading != _meshLoadings.end()) {
+                if ((resource = _joinLoading(loading->second)) == nullptr) {
+                    return nullptr;
+                }
+            }
+            if (resource == nullptr) {
+                auto start = std::chrono::steady_clock::now();
+                std::shared_ptr<VoxelMeshResource::Source> source = _loadSource(_platform, fullFolderPath);
+                
+                if (source->getFrameCount() == 0) {
+                    return nullptr;
+                }
+                
+                std::vector<VoxelMeshResource::Level> levels;
+                levels.reserve(source->getLevelCount());
+                
+                for (std::size_t i = 0; i < source->getLevelCount(); i++) {
+                    levels.emplace_back(VoxelMeshResource::uploadLevel(_renderingDevice, *source, i));
+                }
+                
+                resource = std::make_shared<VoxelMeshResource>(source, std::move(levels), _addSourcePalette(*source));
+                _addResource(fullFolderPath, resource);
+                
+                auto end = std::chrono::steady_clock::now();
+                _loadTimeMs += std::chrono::duration<float, std::milli>(end - start).count();
+                _addTraceEvent(std::string("load ") + fullFolderPath, start, end);
+            }
+            
+            return _makeMesh(resource);
+        }
+        
+        std::shared_future<std::shared_ptr<VoxelMesh>> loadMeshAsync(const char *fullFolderPath, std::function<void(const std::shared_ptr<VoxelMesh> &)> &&completion) {
+            std::shared_ptr<AsyncMeshLoading> &loading = _meshLoadings[fullFolderPath];
+            
+            if (loading == nullptr) {
+                loading = std::make_shared<AsyncMeshLoading>();
+                loading->source = std::make_shared<VoxelMeshResource::Source>();
+                loading->source->path = fullFolderPath;
+                
+                auto cached = _resources.find(fullFolderPath);
+                
+                if (cached != _resources.end() && (loading->resource = cached->second.lock()) != nullptr) {
+                    _finishedLoadings.emplace_back(loading);
+                }
+                else {
+                    _parseAsync(loading, true);
+                }
+            }
+            
+            loading->requests.emplace_back();
+            loading->requests.back().completion = std::move(completion);
+            return loading->requests.back().promise.get_future().share();
+        }
+        
+        std::uint32_t addPalette(const std::uint8_t *rgba) {
+            std::uint32_t row = _defaultPalette;
+            
+            if (_palettes.add(rgba, row) == false) {
+                _platform->logError("[VoxelMeshes] Palette atlas is full (%d rows)", int(PaletteAtlas::MAX_ROWS));
+            }
+            
+            return row;
+        }
+        
+        void setDefaultPalette(std::uint32_t row) {
+            if (row < _palettes.getRowCount()) {
+                _defaultPalette = row;
+            }
+        }
+        
+        std::shared_future<std::uint32_t> loadPaletteAsync(const char *fullPath, bool makeDefault) {
+            std::shared_ptr<AsyncPaletteLoading> loading = std::make_shared<AsyncPaletteLoading>();
+            std::shared_future<std::uint32_t> result = loading->promise.get_future().share();
+            
+            loading->path = fullPath;
+            loading->makeDefault = makeDefault;
+            _decodeAsync(loading);
+            return result;
+        }
+        
+        void setHotReload(bool enabled) {
+            if (enabled && _fileWatcher == nullptr) {
+                _fileWatcher = std::make_unique<FileWatcher>();
+                
+                for (auto &index : _resources) {
+                    if (index.second.expired() == false) {
+                        _watchMesh(index.first);
+                    }
+                }
+                for (auto &index : _paletteFiles) {
+                    _fileWatcher->watch(index.first);
+                }
+            }
+            else if (enabled == false) {
+                _fileWatcher = nullptr;
+            }
+        }
+        
+        // Animations and then culling with recording of draw lists are done in partitions on worker threads.
+        // Finished callbacks and submission of recorded lists are done on rendering thread in partition order.
+        //
+        void updateAndDraw(float dtSec) {
+            if (_fileWatcher) {
+                _updateHotReload();
+            }
+            
+            _updateAsyncLoadings();
+            _renderingDevice->applyTextures({_palettes.getTexture().get()});
+            _batchBuffers.clear();
+            _frustum.set(_camera->getVPMatrix());
+            _statistics = Statistics();
+            
+            auto animationStart = std::chrono::steady_clock::now();
+            std::size_t aliveCount = 0;
+            
+            for (std::size_t i = 0; i < _meshes.size(); i++) {
+                std::shared_ptr<VoxelMeshImp> mesh = _meshes[i].lock();
+                
+                if (mesh == nullptr) {
+                    continue;
+                }
+                
+                if (mesh->getRenderMode() == VoxelMesh::RenderMode::FACES) {
+                    mesh->getResource().prepareFaces(_platform, _renderingDevice);
+                }
+                
+                _meshes[aliveCount++] = _meshes[i];
+                _aliveMeshes.emplace_back(std::move(mesh));
+            }
+            
+            _meshes.resize(aliveCount);
+            _statistics.meshesUpdated = std::uint32_t(aliveCount);
+            
+            std::size_t slotCount = _animations->getSlotCount();
+            std::size_t animationPartitionCount = (slotCount + ANIMATION_PARTITION_SLOTS - 1) / ANIMATION_PARTITION_SLOTS;
+            std::size_t drawPartitionCount = (aliveCount + DRAW_PARTITION_MESHES - 1) / DRAW_PARTITION_MESHES;
+            
+            if (_partitions.size() < std::max(animationPartitionCount, drawPartitionCount)) {
+                _partitions.resize(std::max(animationPartitionCount, drawPartitionCount));
+            }
+            
+            _parallelFor(animationPartitionCount, [this, slotCount, dtSec](std::size_t index) {
+                Partition &partition = _partitions[index];
+                std::size_t begin = index * ANIMATION_PARTITION_SLOTS;
+                partition.frameSwitches = _animations->update(begin, std::min(begin + ANIMATION_PARTITION_SLOTS, slotCount), dtSec, partition.finished);
+            });
+            
+            for (std::size_t i = 0; i < animationPartitionCount; i++) {
+                _statistics.frameSwitches += _partitions[i].frameSwitches;
+                _animations->dispatchFinished(_partitions[i].finished);
+            }
+            
+            auto submissionStart = std::chrono::steady_clock::now();
+            
+            _parallelFor(drawPartitionCount, [this, aliveCount](std::size_t index) {
+                std::size_t begin = index * DRAW_PARTITION_MESHES;
+                _recordPartition(_partitions[index], begin, std::min(begin + DRAW_PARTITION_MESHES, aliveCount));
+            });
+            
+            for (std::size_t i = 0; i < drawPartitionCount; i++) {
+                _submitPartition(_partitions[i]);
+            }
+            
+            _aliveMeshes.clear();
+            
+            auto submissionEnd = std::chrono::steady_clock::now();
+            _statistics.animationTimeMs = std::chrono::duration<float, std::milli>(submissionStart - animationStart).count();
+            _statistics.submissionTimeMs = std::chrono::duration<float, std::milli>(submissionEnd - submissionStart).count();
+            _addTraceEvent("updateAnimation", animationStart, submissionStart);
+            _addTraceEvent("submission", submissionStart, submissionEnd);
+        }
+        
+        void drawVoxels(const std::shared_ptr<platform::StructuredData> &voxels, std::uint32_t voxelCount, const math::transform3f &fullTransform, std::uint32_t paletteRow) {
+            if (voxelCount) {
+                _directConst.transforms[0] = fullTransform;
+                _directConst.transforms[0].flat16[15] = _getPaletteTexcoord(paletteRow);
+                _renderingDevice->applyTextures({_palettes.getTexture().get()});
+                _renderingDevice->applyShader(_shader, &_directConst);
+                _renderingDevice->drawGeometry(nullptr, voxels, HALF_CUBE_VERTEX_COUNT, voxelCount, platform::Topology::TRIANGLESTRIP);
+            }
+        }
+        
+        bool pick(const math::vector3f &origin, const math::vector3f &direction, PickResult &result) {
+            bool found = false;
+            result.distance = std::numeric_limits<float>::max();
+            
+            for (auto &weakMesh : _meshes) {
+                std::shared_ptr<VoxelMeshImp> mesh = weakMesh.lock();
+                float inverse[9];
+                
+                if (mesh == nullptr || invertBasis(mesh->getTransform(), inverse) == false) {
+                    continue;
+                }
+                
+                const float *m = mesh->getTransform().flat16;
+                math::vector3f p = origin - math::vector3f(m[12], m[13], m[14]);
+                math::vector3f localOrigin (
+                    p.x * inverse[0] + p.y * inverse[3] + p.z * inverse[6],
+                    p.x * inverse[1] + p.y * inverse[4] + p.z * inverse[7],
+                    p.x * inverse[2] + p.y * inverse[5] + p.z * inverse[8]
+                );
+                math::vector3f localDirection (
+                    direction.x * inverse[0] + direction.y * inverse[3] + direction.z * inverse[6],
+                    direction.x * inverse[1] + direction.y * inverse[4] + direction.z * inverse[7],
+                    direction.x * inverse[2] + direction.y * inverse[5] + direction.z * inverse[8]
+                );
+                
+                // local ray keeps parameter of world ray, so distances of all meshes are comparable
+                PickGrid::Hit hit;
+                
+                if (mesh->getResource().getPickGrid(mesh->getFrameIndex()).raycast(localOrigin, localDirection, result.distance, hit)) {
+                    float local[3] = {localDirection.x, localDirection.y, localDirection.z};
+                    
+                    found = true;
+                    result.mesh = mesh;
+                    result.distance = hit.distance;
+                    result.position = origin + direction * hit.distance;
+                    result.normal = math::vector3f(0, 0, 0);
+                    result.voxelX = hit.cell[0];
+                    result.voxelY = hit.cell[1];
+                    result.voxelZ = hit.cell[2];
+                    result.colorIndex = hit.colorIndex;
+                    
+                    if (hit.faceAxis >= 0) {
+                        float sign = local[hit.faceAxis] > 0.0f ? -1.0f : 1.0f;
+                        result.normal = math::vector3f(inverse[hit.faceAxis], inverse[3 + hit.faceAxis], inverse[6 + hit.faceAxis]).normalized() * sign;
+                    }
+                }
+            }
+            
+            return found;
+        }
+        
+        Statistics getStatistics() const {
+            Statistics result = _statistics;
+            result.meshesLoaded = _meshesLoaded;
+            result.loadTimeMs = _loadTimeMs;
+            result.meshesReloaded = _meshesReloaded;
+            result.paletteRows = _palettes.getRowCount();
+            
+            for (auto &index : _resources) {
+                if (std::shared_ptr<const VoxelMeshResource> resource = index.second.lock()) {
+                    result.gpuBytes += resource->getVoxelBytes();
+                }
+            }
+            
+            return result;
+        }
+        
+        bool writeTrace(const char *fullPath) {
+            bool result = false;
+            
+            if (std::FILE *file = std::fopen(fullPath, "w")) {
+                std::fprintf(file, "{\"traceEvents\":[\n");
+                
+                for (std::size_t i = 0; i < _traceEvents.size(); i++) {
+                    const TraceEvent &event = _traceEvents[i];
+                    std::string name;
+                    
+                    for (char c : event.name) {
+                        if (c == '"' || c == '\\') {
+                            name += '\\';
+                        }
+                        if (std::uint8_t(c) >= 0x20) {
+                            name += c;
+                        }
+                    }
+                    
+                    std::fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"dur\":%lld}%s\n",
+                        name.data(), event.threadId, (long long)event.startUs, (long long)event.durationUs, i + 1 < _traceEvents.size() ? "," : "");
+                }
+                
+                std::fprintf(file, "]}\n");
+                result = std::fclose(file) == 0;
+            }
+            if (result == false) {
+                _platform->logError("[VoxelMeshes] Unable to write trace '%s'", fullPath);
+            }
+            
+            _traceEvents.clear();
+            return result;
+        }
+        
+        std::shared_ptr<platform::Platform> _platform;
+        std::shared_ptr<platform::RenderingDevice> _renderingDevice;
+        std::shared_ptr<platform::Shader> _shader;
+        std::shared_ptr<platform::Shader> _faceShader;
+        std::vector<std::weak_ptr<VoxelMeshImp>> _meshes;
+        std::unordered_map<std::string, std::weak_ptr<const VoxelMeshResource>> _resources;
+        PaletteAtlas _palettes;
+        PaletteCache _paletteCache;
+        std::uint32_t _defaultPalette = 0;
+        std::shared_ptr<Camera> _camera;
+        
+        Frustum _frustum;
+        float _drawDistance = std::numeric_limits<float>::max();
+        std::vector<std::shared_ptr<VoxelMeshImp>> _aliveMeshes; // meshes of current updateAndDraw
+        std::shared_ptr<AnimationPool> _animations = std::make_shared<AnimationPool>(); // meshes may outlive VoxelMeshes
+        std::vector<float> _lodDistances = {std::begin(DEFAULT_LOD_DISTANCES), std::end(DEFAULT_LOD_DISTANCES)};
+        Statistics _statistics;
+        std::uint32_t _meshesLoaded = 0;
+        std::uint32_t _meshesReloaded = 0;
+        float _loadTimeMs = 0.0f;
+        
+        // Hot reload: file paths of loadPaletteAsync with their rows, generation of the latest reload of mesh folder
+        std::unique_ptr<FileWatcher> _fileWatcher;
+        std::unordered_map<std::string, std::uint32_t> _paletteFiles;
+        std::unordered_map<std::string, std::uint32_t> _reloadGenerations;
+        
+        // Complete events of Chrome trace format, loading on worker threads is shown as separate thread
+        struct TraceEvent {
+            std::string name;
+            std::int64_t startUs;
+            std::int64_t durationUs;
+            std::uint32_t threadId;
+        };
+        
+        bool _tracing = false;
+        std::vector<TraceEvent> _traceEvents;
+        std::chrono::steady_clock::time_point _creationTime = std::chrono::steady_clock::now();
+        
+        struct AsyncMeshRequest {
+            std::promise<std::shared_ptr<VoxelMesh>> promise;
+            std::function<void(const std::shared_ptr<VoxelMesh> &)> completion;
+        };
+        
+        struct AsyncMeshLoading {
+            std::shared_ptr<VoxelMeshResource::Source> source;
+            std::vector<VoxelMeshResource::Level> uploadedLevels;
+            std::size_t uploadedUnits = 0; // base or frame of some level
+            std::chrono::steady_clock::time_point parseStart, parseEnd;
+            std::shared_ptr<const VoxelMeshResource> resource;
+            std::vector<AsyncMeshRequest> requests;
+            std::uint32_t reload = 0; // generation of hot reload, zero for loading by request
+        };
+        
+        struct AsyncPaletteLoading {
+            std::string path;
+            bool makeDefault;
+            bool reload = false;
+            std::vector<std::uint8_t> rgba;
+            std::promise<std::uint32_t> promise;
+        };
+        
+        // rendering thread only
+        std::unordered_map<std::string, std::shared_ptr<AsyncMeshLoading>> _meshLoadings;
+        std::deque<std::shared_ptr<AsyncMeshLoading>> _uploadingLoadings;
+        std::vector<std::shared_ptr<AsyncMeshLoading>> _finishedLoadings;
+        
+        // guarded by _asyncMutex
+        std::mutex _asyncMutex;
+        std::vector<std::shared_ptr<AsyncMeshLoading>> _parsedLoadings;
+        std::vector<std::shared_ptr<AsyncPaletteLoading>> _decodedPalettes;
+        std::condition_variable _parsedCondition;
+        
+        // Faces of mesh in FACES mode with bit per direction which may face camera
+        struct FaceDraw {
+            const VoxelMeshImp *mesh;
+            std::uint32_t directions;
+        };
+        
+        // Draw list of partition. Batches are consecutive ranges of batchVoxels ending at batchEnds.
+        struct Partition {
+            AnimationPool::Finished finished;
+            std::uint32_t frameSwitches = 0;
+            std::uint32_t meshesDrawn = 0;
+            std::uint32_t meshesCulled = 0;
+            std::vector<FaceDraw> faceDraws;
+            std::vector<const VoxelMeshImp *> directMeshes;
+            std::vector<VoxelMeshShaderBatchConst> batchConsts;
+            std::vector<std::size_t> batchEnds;
+            std::vector<voxel::Voxel> batchVoxels;
+        };
+        
+        std::vector<Partition> _partitions;
+        VoxelMeshShaderBatchConst _directConst;
+        VoxelFaceShaderMeshConst _faceConst;
+        std::vector<std::shared_ptr<platform::StructuredData>> _batchBuffers;
+        
+        // created on first asynchronous request or parallel update, destroyed first so workers never outlive the fields above
+        std::unique_ptr<ThreadPool> _threadPool;
+        
+    private:
+        ThreadPool &_getThreadPool() {
+            if (_threadPool == nullptr) {
+                _threadPool = std::make_unique<ThreadPool>();
+            }
+            
+            return *_threadPool;
+        }
+        
+        // @distance is set to distance from camera to the world bounds center
+        //
+        bool _isCulled(const VoxelMeshImp &mesh, float &distance) const {
+            const VoxelMeshResource &resource = mesh.getResource();
+            math::vector3f center = transformPoint(mesh.getTransform(), resource.getBoundsCenter());
+            math::vector3f extent = transformExtent(mesh.getTransform(), resource.getBoundsExtent());
+            
+            distance = (center - _camera->getPosition()).length();
+            
+            if (distance - extent.length() > _drawDistance) {
+                return true;
+            }
+            
+            return _frustum.isBoxVisible(center, extent) == false;
+        }
+        
+        void _addTraceEvent(std::string &&name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, std::uint32_t threadId = 0) {
+            if (_tracing && _traceEvents.size() < MAX_TRACE_EVENTS) {
+                _traceEvents.emplace_back(TraceEvent {
+                    std::move(name),
+                    std::chrono::duration_cast<std::chrono::microseconds>(start - _creationTime).count(),
+                    std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(),
+                    threadId
+                });
+            }
+        }
+        
+        void _addResource(const std::string &path, const std::shared_ptr<const VoxelMeshResource> &resource) {
+            _resources[path] = resource;
+            _meshesLoaded++;
+            
+            if (_fileWatcher) {
+                _watchMesh(path);
+            }
+            
+            _platform->logMsg("[VoxelMeshes] '%s': %d frames, %d levels of detail, %d bytes of voxels", path.data(), int(resource->getFrameCount()), int(resource->getLevelCount()), int(resource->getVoxelBytes()));
+        }
+        
+        std::uint32_t _addSourcePalette(const VoxelMeshResource::Source &source) {
+            const std::uint8_t *rgba = source.getPalette();
+            std::uint32_t row = DEFAULT_PALETTE;
+            
+            if (rgba && _palettes.add(rgba, row) == false) {
+                _platform->logError("[VoxelMeshes] Palette atlas is full, '%s' uses default palette", source.path.data());
+                row = DEFAULT_PALETTE;
+            }
+            
+            return row;
+        }
+        
+        // Resources take reference to row of embedded palette, which is released when resource is replaced by reload,
+        // so edited palettes don't pile up in atlas. Rows of resources dropped with their meshes are kept for the next load.
+        //
+        void _releaseSourcePalette(const VoxelMeshResource &resource) {
+            if (resource.getPaletteRow() != DEFAULT_PALETTE) {
+                _palettes.release(resource.getPaletteRow());
+            }
+        }
+        
+        // Mesh transform for shader constants: w of row3 is v texcoord of mesh palette row
+        //
+        // Unknown row means default palette
+        //
+        float _getPaletteTexcoord(std::uint32_t row) const {
+            return _palettes.getRowTexcoord(row < _palettes.getRowCount() ? row : _defaultPalette);
+        }
+        
+        math::transform3f _getShaderTransform(const VoxelMeshImp &mesh) const {
+            math::transform3f result = mesh.getTransform();
+            result.flat16[15] = _getPaletteTexcoord(mesh.getPaletteRow());
+            return result;
+        }
+        
+        std::shared_ptr<VoxelMesh> _makeMesh(const std::shared_ptr<const VoxelMeshResource> &resource) {
+            std::shared_ptr<VoxelMeshImp> mesh = std::make_shared<VoxelMeshImp>(_platform, _animations, resource);
+            _meshes.emplace_back(mesh);
+            return mesh;
+        }
+        
+        void _parseAsync(const std::shared_ptr<AsyncMeshLoading> &loading, bool useCooked) {
+            _getThreadPool().push([this, loading, useCooked, platform = _platform] {
+                auto start = std::chrono::steady_clock::now();
+                std::shared_ptr<VoxelMeshResource::Source> source = _loadSource(platform, loading->source->path.data(), useCooked);
+                auto end = std::chrono::steady_clock::now();
+                std::lock_guard<std::mutex> guard (_asyncMutex);
+                loading->source = std::move(source);
+                loading->parseStart = start;
+                loading->parseEnd = end;
+                _parsedLoadings.emplace_back(loading);
+                _parsedCondition.notify_all();
+            });
+        }
+        
+        void _decodeAsync(const std::shared_ptr<AsyncPaletteLoading> &loading) {
+            _getThreadPool().push([this, loading, platform = _platform] {
+                voxel::decodePalette(platform, loading->path.data(), loading->rgba, &_paletteCache);
+                std::lock_guard<std::mutex> guard (_asyncMutex);
+                _decodedPalettes.emplace_back(loading);
+            });
+        }
+        
+        void _watchMesh(const std::string &path) {
+            _fileWatcher->watch(path + "/model.vox");
+            _fileWatcher->watch(path + "/model.info");
+            _fileWatcher->watch(path + "/model.cooked");
+        }
+        
+        // Changed files are reparsed and uploaded as asynchronous loadings, meshes are switched by _finishReload.
+        // Changed model.vox or model.info is parsed even if folder has model.cooked, which is stale then.
+        //
+        void _updateHotReload() {
+            std::unordered_map<std::string, bool> folders; // folder -> only model.cooked is changed
+            
+            _fileWatcher->poll([&](const std::string &fullPath) {
+                if (_paletteFiles.count(fullPath)) {
+                    std::shared_ptr<AsyncPaletteLoading> loading = std::make_shared<AsyncPaletteLoading>();
+                    loading->path = fullPath;
+                    loading->makeDefault = false;
+                    loading->reload = true;
+                    _decodeAsync(loading);
+                }
+                else {
+                    std::size_t slash = fullPath.rfind('/');
+                    bool cooked = fullPath.compare(slash + 1, std::string::npos, "model.cooked") == 0;
+                    auto folder = folders.emplace(fullPath.substr(0, slash), cooked).first;
+                    folder->second = folder->second && cooked;
+                }
+            });
+            
+            for (auto &folder : folders) {
+                std::shared_ptr<AsyncMeshLoading> loading = std::make_shared<AsyncMeshLoading>();
+                loading->source = std::make_shared<VoxelMeshResource::Source>();
+                loading->source->path = folder.first;
+                loading->reload = ++_reloadGenerations[folder.first];
+                _parseAsync(loading, folder.second);
+            }
+        }
+        
+        // Called at the start of updateAndDraw, so every mesh is drawn with the new resource from this frame.
+        // Previous resource (and its GPU buffers) is released with the last mesh using it.
+        //
+        void _finishReload(const AsyncMeshLoading &loading) {
+            const std::string &path = loading.source->path;
+            auto cached = _resources.find(path);
+            std::shared_ptr<const VoxelMeshResource> previous = cached != _resources.end() ? cached->second.lock() : nullptr;
+            
+            if (previous == nullptr || loading.reload != _reloadGenerations[path]) {
+                if (loading.resource) {
+                    _releaseSourcePalette(*loading.resource);
+                }
+                
+                return;
+            }
+            if (loading.resource == nullptr) {
+                _platform->logError("[VoxelMeshes] Unable to reload '%s', meshes keep previous data", path.data());
+                return;
+            }
+            
+            std::uint32_t switched = 0;
+            cached->second = loading.resource;
+            
+            for (auto &weakMesh : _meshes) {
+                std::shared_ptr<VoxelMeshImp> mesh = weakMesh.lock();
+                
+                if (mesh && &mesh->getResource() == previous.get()) {
+                    mesh->setResource(loading.resource);
+                    switched++;
+                }
+            }
+            
+            _releaseSourcePalette(*previous);
+            _meshesReloaded++;
+            _platform->logMsg("[VoxelMeshes] '%s' is reloaded: %d frames, %d meshes switched", path.data(), int(loading.resource->getFrameCount()), int(switched));
+        }
+        
+        // Parsed loading goes to upload queue
+        //
+        void _takeParsed(const std::shared_ptr<AsyncMeshLoading> &loading) {
+            _uploadingLoadings.emplace_back(loading);
+            _loadTimeMs += std::chrono::duration<float, std::milli>(loading->parseEnd - loading->parseStart).count();
+            _addTraceEvent("parse " + loading->source->path, loading->parseStart, loading->parseEnd, 1);
+        }
+        
+        // Uploads base and frames of @loading while @hasBudget, sets @uploaded if anything is uploaded.
+        // Returns true when all of them are uploaded and resource is created (it stays nullptr if source has no frames).
+        //
+        bool _upload(AsyncMeshLoading &loading, const std::function<bool()> &hasBudget, bool &uploaded) {
+            std::size_t frameCount = loading.source->getFrameCount();
+            std::size_t unitCount = frameCount ? loading.source->getLevelCount() * (frameCount + 1) : 0;
+            auto uploadStart = std::chrono::steady_clock::now();
+            
+            while (loading.uploadedUnits < unitCount && hasBudget()) {
+                std::size_t level = loading.uploadedUnits / (frameCount + 1);
+                std::size_t index = loading.uploadedUnits % (frameCount + 1);
+                
+                if (index == 0) {
+                    loading.uploadedLevels.emplace_back();
+                    loading.uploadedLevels.back().base = VoxelMeshResource::uploadBase(_renderingDevice, *loading.source, level);
+                }
+                else {
+                    loading.uploadedLevels.back().frames.emplace_back(VoxelMeshResource::uploadFrame(_renderingDevice, *loading.source, level, index - 1));
+                }
+                
+                loading.uploadedUnits++;
+                uploaded = true;
+            }
+            
+            auto uploadEnd = std::chrono::steady_clock::now();
+            _loadTimeMs += std::chrono::duration<float, std::milli>(uploadEnd - uploadStart).count();
+            _addTraceEvent("upload " + loading.source->path, uploadStart, uploadEnd);
+            
+            if (loading.uploadedUnits == unitCount && hasBudget()) {
+                if (frameCount) {
+                    loading.resource = std::make_shared<VoxelMeshResource>(loading.source, std::move(loading.uploadedLevels), _addSourcePalette(*loading.source));
+                    
+                    if (loading.reload == 0) {
+                        _addResource(loading.source->path, loading.resource);
+                    }
+                }
+                
+                return true;
+            }
+            
+            return false;
+        }
+        
+        // Waits for parsing of requested @loading and uploads it without budget. Its requests are fulfilled by the next
+        // _updateAsyncLoadings as usual. Returns nullptr if mesh can't be loaded.
+        //
+        std::shared_ptr<const VoxelMeshResource> _joinLoading(const std::shared_ptr<AsyncMeshLoading> &loading) {
+            if (std::find(_finishedLoadings.begin(), _finishedLoadings.end(), loading) != _finishedLoadings.end()) {
+                return loading->resource;
+            }
+            
+            auto uploading = std::find(_uploadingLoadings.begin(), _uploadingLoadings.end(), loading);
+            
+            if (uploading == _uploadingLoadings.end()) {
+                std::unique_lock<std::mutex> lock (_asyncMutex);
+                std::vector<std::shared_ptr<AsyncMeshLoading>>::iterator parsed;
+                
+                _parsedCondition.wait(lock, [&] {
+                    return (parsed = std::find(_parsedLoadings.begin(), _parsedLoadings.end(), loading)) != _parsedLoadings.end();
+                });
+                
+                _parsedLoadings.erase(parsed);
+                lock.unlock();
+                _takeParsed(loading);
+                uploading = std::prev(_uploadingLoadings.end());
+            }
+            
+            bool uploaded = false;
+            _upload(*loading, [] { return true; }, uploaded);
+            _uploadingLoadings.erase(uploading);
+            _finishedLoadings.emplace_back(loading);
+            return loading->resource;
+        }
+        
+        void _updateAsyncLoadings() {
+            std::vector<std::shared_ptr<AsyncPaletteLoading>> palettes;
+            
+            {
+                std::lock_guard<std::mutex> guard (_asyncMutex);
+                
+                for (auto &loading : _parsedLoadings) {
+                    _takeParsed(loading);
+                }
+                
+                _parsedLoadings.clear();
+                palettes.swap(_decodedPalettes);
+            }
+            
+            auto start = std::chrono::steady_clock::now();
+            bool uploaded = false;
+            
+            auto hasBudget = [&] {
+                return uploaded == false || std::chrono::steady_clock::now() - start < ASYNC_UPLOAD_BUDGET;
+            };
+            
+            for (auto &palette : palettes) {
+                std::uint32_t row = _defaultPalette;
+                
+                if (palette->rgba.size() == PaletteAtlas::PALETTE_BYTES) {
+                    auto file = _paletteFiles.find(palette->path);
+                    
+                    if (file != _paletteFiles.end()) {
+                        _palettes.replace(file->second, palette->rgba.data());
+                        row = file->second;
+                        _defaultPalette = palette->makeDefault ? row : _defaultPalette;
+                    }
+                    else if (_palettes.addPrivate(palette->rgba.data(), row)) {
+                        _paletteFiles[palette->path] = row;
+                        _defaultPalette = palette->makeDefault ? row : _defaultPalette;
+                        
+                        if (_fileWatcher) {
+                            _fileWatcher->watch(palette->path);
+                        }
+                    }
+                    else {
+                        _platform->logError("[VoxelMeshes] Palette atlas is full, '%s' is not added", palette->path.data());
+                    }
+                }
+                
+                palette->promise.set_value(row);
+                uploaded = true;
+            }
+            
+            while (_uploadingLoadings.size() && hasBudget()) {
+                if (_upload(*_uploadingLoadings.front(), hasBudget, uploaded)) {
+                    _finishedLoadings.emplace_back(std::move(_uploadingLoadings.front()));
+                    _uploadingLoadings.pop_front();
+                }
+            }
+            
+            // completions may load meshes, which adds finished loadings
+            std::vector<std::shared_ptr<AsyncMeshLoading>> finished;
+            finished.swap(_finishedLoadings);
+            
+            for (auto &loading : finished) {
+                if (loading->reload == 0) {
+                    _meshLoadings.erase(loading->source->path);
+                }
+            }
+            for (auto &loading : finished) {
+                if (loading->reload) {
+                    _finishReload(*loading);
+                    continue;
+                }
+                
+                for (auto &request : loading->requests) {
+                    std::shared_ptr<VoxelMesh> mesh = loading->resource ? _makeMesh(loading->resource) : nullptr;
+                    request.promise.set_value(mesh);
+                    
+                    if (request.completion) {
+                        request.completion(mesh);
+                    }
+                }
+            }
+        }
+        
+        void _parallelFor(std::size_t count, const std::function<void(std::size_t)> &task) {
+            if (count > 1) {
+                _getThreadPool().parallelFor(count, task);
+            }
+            else if (count) {
+                task(0);
+            }
+        }
+        
+        // Culls meshes [begin, end) of _aliveMeshes and records what is left. Called from any thread.
+        //
+        void _recordPartition(Partition &partition, std::size_t begin, std::size_t end) const {
+            std::uint32_t batchMeshCount = MAX_BATCH_MESHES;
+            
+            partition.meshesDrawn = 0;
+            partition.meshesCulled = 0;
+            partition.faceDraws.clear();
+            partition.directMeshes.clear();
+            partition.batchConsts.clear();
+            partition.batchEnds.clear();
+            partition.batchVoxels.clear();
+            
+            for (std::size_t i = begin; i < end; i++) {
+                VoxelMeshImp &mesh = *_aliveMeshes[i];
+                float distance = 0.0f;
+                
+                if (_isCulled(mesh, distance)) {
+                    partition.meshesCulled++;
+                    continue;
+                }
+                
+                mesh.updateLod(distance, _lodDistances);
+                
+                partition.meshesDrawn++;
+                const VoxelMeshResource::Frame *parts[] = {&mesh.getBase(), &mesh.getFrame()};
+                std::size_t voxelCount = parts[0]->voxelCount + parts[1]->voxelCount;
+                
+                if (mesh.getRenderMode() == VoxelMesh::RenderMode::FACES) {
+                    partition.faceDraws.emplace_back(FaceDraw {&mesh, _getFacingDirections(mesh)});
+                }
+                else if (voxelCount >= DIRECT_DRAW_VOXEL_COUNT) {
+                    partition.directMeshes.emplace_back(&mesh);
+                }
+                else {
+                    std::size_t batchStart = partition.batchEnds.size() ? partition.batchEnds.back() : 0;
+                    
+                    if (batchMeshCount == MAX_BATCH_MESHES || partition.batchVoxels.size() - batchStart + voxelCount > MAX_BATCH_VOXELS) {
+                        partition.batchEnds.emplace_back(partition.batchVoxels.size());
+                        partition.batchConsts.emplace_back();
+                        batchMeshCount = 0;
+                    }
+                    
+                    std::size_t start = partition.batchVoxels.size();
+                    
+                    for (const VoxelMeshResource::Frame *part : parts) {
+                        partition.batchVoxels.insert(partition.batchVoxels.end(), part->voxels, part->voxels + part->voxelCount);
+                    }
+                    for (std::size_t c = start; c < partition.batchVoxels.size(); c++) {
+                        partition.batchVoxels[c].reserved = std::int16_t(batchMeshCount);
+                    }
+                    
+                    partition.batchConsts.back().transforms[batchMeshCount++] = _getShaderTransform(mesh);
+                    partition.batchEnds.back() = partition.batchVoxels.size();
+                }
+            }
+        }
+        
+        // Faces of direction d lie on planes inside mesh bounds, so they are turned away when camera is behind bounds side opposite to d.
+        // Degenerate transform gives all directions.
+        //
+        std::uint32_t _getFacingDirections(const VoxelMeshImp &mesh) const {
+            float inverse[9];
+            
+            if (invertBasis(mesh.getTransform(), inverse) == false) {
+                return 0x3f;
+            }
+            
+            const float *m = mesh.getTransform().flat16;
+            math::vector3f p = _camera->getPosition() - math::vector3f(m[12], m[13], m[14]);
+            float camera[3] = {
+                p.x * inverse[0] + p.y * inverse[3] + p.z * inverse[6],
+                p.x * inverse[1] + p.y * inverse[4] + p.z * inverse[7],
+                p.x * inverse[2] + p.y * inverse[5] + p.z * inverse[8]
+            };
+            
+            const math::vector3f &center = mesh.getResource().getBoundsCenter();
+            const math::vector3f &extent = mesh.getResource().getBoundsExtent();
+            float boundsMin[3] = {center.x - extent.x, center.y - extent.y, center.z - extent.z};
+            float boundsMax[3] = {center.x + extent.x, center.y + extent.y, center.z + extent.z};
+            std::uint32_t result = 0;
+            
+            for (int a = 0; a < 3; a++) {
+                result |= (camera[a] > boundsMin[a] ? 1u : 0u) << (a * 2);
+                result |= (camera[a] < boundsMax[a] ? 1u : 0u) << (a * 2 + 1);
+            }
+            
+            return result;
+        }
+        
+        void _submitPartition(const Partition &partition) {
+            _statistics.meshesDrawn += partition.meshesDrawn;
+            _statistics.meshesCulled += partition.meshesCulled;
+            
+            for (const FaceDraw &draw : partition.faceDraws) {
+                const VoxelMeshResource::Faces &faces = draw.mesh->getFaces();
+                
+                _faceConst.transform = _getShaderTransform(*draw.mesh);
+                _renderingDevice->applyShader(_faceShader, &_faceConst);
+                
+                for (int direction = 0; direction < 6; direction++) {
+                    if (faces.faceCount[direction] && (draw.directions >> direction & 1)) {
+                        _renderingDevice->drawGeometry(nullptr, faces.data[direction], FACE_VERTEX_COUNT, faces.faceCount[direction], platform::Topology::TRIANGLESTRIP);
+                        _statistics.drawCalls++;
+                        _statistics.instancesSubmitted += faces.faceCount[direction];
+                        _statistics.verticesSubmitted += faces.faceCount[direction] * FACE_VERTEX_COUNT;
+                    }
+                }
+            }
+            
+            for (const VoxelMeshImp *mesh : partition.directMeshes) {
+                _directConst.transforms[0] = _getShaderTransform(*mesh);
+                _renderingDevice->applyShader(_shader, &_directConst);
+                
+                for (const VoxelMeshResource::Frame *part : {&mesh->getBase(), &mesh->getFrame()}) {
+                    if (part->voxelCount) {
+                        _renderingDevice->drawGeometry(nullptr, part->data, HALF_CUBE_VERTEX_COUNT, part->voxelCount, platform::Topology::TRIANGLESTRIP);
+                        _statistics.drawCalls++;
+                        _statistics.instancesSubmitted += part->voxelCount;
+                        _statistics.verticesSubmitted += part->voxelCount * HALF_CUBE_VERTEX_COUNT;
+                    }
+                }
+            }
+            
+            for (std::size_t i = 0, start = 0; i < partition.batchEnds.size(); start = partition.batchEnds[i++]) {
+                std::uint32_t voxelCount = std::uint32_t(partition.batchEnds[i] - start);
+                
+                if (voxelCount) {
+                    _batchBuffers.emplace_back(_renderingDevice->createData(&partition.batchVoxels[start], voxelCount, sizeof(voxel::Voxel)));
+                    _renderingDevice->applyShader(_shader, &partition.batchConsts[i]);
+                    _renderingDevice->drawGeometry(nullptr, _batchBuffers.back(), HALF_CUBE_VERTEX_COUNT, voxelCount, platform::Topology::TRIANGLESTRIP);
+                    _statistics.drawCalls++;
+                    _statistics.instancesSubmitted += voxelCount;
+                    _statistics.verticesSubmitted += voxelCount * HALF_CUBE_VERTEX_COUNT;
+                }
+            }
+        }
+        
+        // Reads and optimizes mesh data or maps cooked one (unless @useCooked is false). Called from worker threads for asynchronous loading.
+        // File contents and parsing intermediates live in arena of the calling thread, which is reset after every load
+        // and keeps up to LOAD_ARENA_KEPT_BYTES of its blocks, so bulk loading allocates only the resulting frames.
+        //
+        static std::shared_ptr<VoxelMeshResource::Source> _loadSource(const std::shared_ptr<platform::Platform> &platform, const char *fullFolderPath, bool useCooked = true) {
+            static thread_local Arena arena;
+            
+            std::shared_ptr<VoxelMeshResource::Source> result = std::make_shared<VoxelMeshResource::Source>();
+            std::string cookedPath = std::string(fullFolderPath) + "/model.cooked";
+            
+            std::vector<voxel::AnimationInfo> animations;
+            
+            result->path = fullFolderPath;
+            
+            if (useCooked && (result->cooked = voxel::CookedModel::open(platform, cookedPath.data())) != nullptr) {
+                animations.reserve(result->cooked->getAnimationCount());
+                
+                for (std::uint32_t i = 0; i < result->cooked->getAnimationCount(); i++) {
+                    animations.emplace_back(result->cooked->getAnimation(i));
+                }
+            }
+            else {
+                std::string infoPath = std::string(fullFolderPath) + "/model.info";
+                std::string modelPath = std::string(fullFolderPath) + "/model.vox";
+                voxel::ModelInfo info;
+                
+                voxel::loadModelInfo(platform, infoPath.data(), info, &arena);
+                voxel::loadModel(platform, modelPath.data(), voxel::makeModelOptions(info), result->model, &arena);
+                arena.trim(LOAD_ARENA_KEPT_BYTES);
+                animations = std::move(info.animations);
+            }
+            
+            // The only check of animation ranges: playback and reload take frames of animations as is
+            std::size_t frameCount = result->getFrameCount();
+            result->animations.reserve(animations.size());
+            
+            for (auto &animation : animations) {
+                if (animation.firstFrame <= animation.lastFrame && animation.lastFrame < frameCount) {
+                    result->addAnimation(animation.name, VoxelMeshResource::Animation {animation.firstFrame, animation.lastFrame, animation.frameRate});
+                }
+                else if (frameCount) {
+                    platform->logError("[VoxelMeshes] Animation '%s' of '%s' is out of %d frames and is ignored", animation.name.data(), fullFolderPath, int(frameCount));
+                }
+            }
+            
+            result->sortAnimations();
+            return result;
+        }
     };
 
     std::shared_ptr<VoxelMesh> VoxelMeshes::loadMesh(const char *fullFolderPath) {
         return static_cast<VoxelMeshesImp *>(this)->loadMesh(fullFolderPath);
     }
 
+    std::shared_future<std::shared_ptr<VoxelMesh>> VoxelMeshes::loadMeshAsync(const char *fullFolderPath, std::function<void(const std::shared_ptr<VoxelMesh> &)> &&completion) {
+        return static_cast<VoxelMeshesImp *>(this)->loadMeshAsync(fullFolderPath, std::move(completion));
+    }
+
+    std::uint32_t VoxelMeshes::addPalette(const std::uint8_t *rgba) {
+        return static_cast<VoxelMeshesImp *>(this)->addPalette(rgba);
+    }
+
+    std::shared_future<std::uint32_t> VoxelMeshes::loadPaletteAsync(const char *fullPath, bool makeDefault) {
+        return static_cast<VoxelMeshesImp *>(this)->loadPaletteAsync(fullPath, makeDefault);
+    }
+
+    void VoxelMeshes::setDefaultPalette(std::uint32_t row) {
+        static_cast<VoxelMeshesImp *>(this)->setDefaultPalette(row);
+    }
+
+    void VoxelMeshes::setHotReload(bool enabled) {
+        static_cast<VoxelMeshesImp *>(this)->setHotReload(enabled);
+    }
+
     void VoxelMeshes::updateAndDraw(float dt) {
         static_cast<VoxelMeshesImp *>(this)->updateAndDraw(dt);
     }
 
+    void VoxelMeshes::drawVoxels(const std::shared_ptr<platform::StructuredData> &voxels, std::uint32_t voxelCount, const math::transform3f &fullTransform, std::uint32_t paletteRow) {
+        static_cast<VoxelMeshesImp *>(this)->drawVoxels(voxels, voxelCount, fullTransform, paletteRow);
+    }
+
+    void VoxelMeshes::setDrawDistance(float distance) {
+        static_cast<VoxelMeshesImp *>(this)->_drawDistance = distance;
+    }
+
+    void VoxelMeshes::setLodDistances(const std::vector<float> &distances) {
+        static_cast<VoxelMeshesImp *>(this)->_lodDistances = distances;
+    }
+
+    bool VoxelMeshes::pick(const math::vector3f &origin, const math::vector3f &direction, PickResult &result) {
+        return static_cast<VoxelMeshesImp *>(this)->pick(origin, direction, result);
+    }
+
+    VoxelMeshes::Statistics VoxelMeshes::getStatistics() const {
+        return static_cast<const VoxelMeshesImp *>(this)->getStatistics();
+    }
+
+    void VoxelMeshes::setTracing(bool enabled) {
+        static_cast<VoxelMeshesImp *>(this)->_tracing = enabled;
+    }
+
+    bool VoxelMeshes::writeTrace(const char *fullPath) {
+        return static_cast<VoxelMeshesImp *>(this)->writeTrace(fullPath);
+    }
+
     std::shared_ptr<VoxelMeshes> makeVoxelMeshes(
         const std::shared_ptr<platform::Platform> &platform,
         const std::shared_ptr<platform::RenderingDevice> &renderingDevice,
-        const std::shared_ptr<platform::Texture2D> &palette
+        const std::shared_ptr<Camera> &camera,
+        const std::vector<std::uint8_t> &palette
     ) {
-        return std::make_shared<VoxelMeshesImp>(platform, renderingDevice, palette);
+        return std::make_shared<VoxelMeshesImp>(platform, renderingDevice, camera, palette);
     }
 }
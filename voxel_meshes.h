@@ -3,18 +3,57 @@
 
 #include <cstdint>
 #include <memory>
+#include <vector>
+#include <future>
 #include <functional>
 
 #include "utility/math.h"
 #include "utility/common.h"
 
 #include "platform/interfaces.h"
+#include "camera.h"
 
 namespace voxel {
     class VoxelMesh : public utility::NonCopyable, public utility::NonMovable {
     public:
         void setTransform(const math::transform3f &fullTransform);
+        enum class Playback {
+            ONCE,
+            LOOP,
+            PING_PONG
+        };
+        
+        // Starts animation from its first frame, replacing current and queued ones. Animation frame follows elapsed time,
+        // so frames are skipped when updateAndDraw is called rarely. Mesh shows frame 0 when nothing is playing.
+        // @finished is called once inside updateAndDraw when animation ends (looping one ends only to start queued animation),
+        // it's not called if animation is replaced. @speed scales animation time.
+        //
         void playAnimation(const char *name, std::function<void(VoxelMesh&)> &&finished);
+        void playAnimation(const char *name, Playback playback, float speed = 1.0f, std::function<void(VoxelMesh&)> &&finished = nullptr);
+        
+        // Animation is started when current and already queued ones end, looping animation ends at the end of its cycle.
+        // Starts immediately if nothing is playing.
+        //
+        void queueAnimation(const char *name, Playback playback = Playback::ONCE, float speed = 1.0f, std::function<void(VoxelMesh&)> &&finished = nullptr);
+        
+        enum class RenderMode {
+            VOXELS, // every voxel is instanced as half-cube facing camera, small meshes are drawn in batches
+            FACES   // visible faces merged into quads per color and direction, faces turned away from camera are skipped
+        };
+        
+        // FACES costs less vertices and overdraw for large static props, but every mesh takes own draw calls.
+        // Faces of all frames and levels are built and uploaded by the next updateAndDraw, then shared with meshes of the same folder.
+        //
+        void setRenderMode(RenderMode mode);
+        
+        // Row of VoxelMeshes palette atlas used for colors of this mesh (see VoxelMeshes::addPalette).
+        // Mesh starts with palette embedded into its model.vox or with default palette. Unknown row means default palette.
+        //
+        void setPalette(std::uint32_t row);
+        
+        // Bytes of GPU buffers with voxels (and faces) of this mesh. Buffers are shared by meshes loaded from the same folder.
+        //
+        std::size_t getGpuBytes() const;
 
     protected:
         VoxelMesh() = default;
@@ -22,8 +61,100 @@ namespace voxel {
 
     class VoxelMeshes : public utility::NonCopyable, public utility::NonMovable {
     public:
+        // Meshes loaded from the same folder share frames and animations.
+        // Mesh is drawn while there are references to it.
+        //
         std::shared_ptr<VoxelMesh> loadMesh(const char *fullFolderPath);
+        
+        // Files are read and parsed on worker threads, GPU data is created by updateAndDraw within a time budget.
+        // Futures become ready and @completion is called inside updateAndDraw, so don't wait for them on rendering thread.
+        // Result is nullptr if mesh can't be loaded.
+        //
+        std::shared_future<std::shared_ptr<VoxelMesh>> loadMeshAsync(const char *fullFolderPath, std::function<void(const std::shared_ptr<VoxelMesh> &)> &&completion = nullptr);
+        
+        // Palettes (256 RGBA colors) are rows of one texture, so meshes with different palettes are still drawn in batches.
+        // Equal palettes share a row. Returns row for VoxelMesh::setPalette, or default row if atlas is full (256 rows).
+        //
+        std::uint32_t addPalette(const std::uint8_t *rgba);
+        
+        // Decodes palette png on worker thread and adds it to atlas, result is its row (default row if it can't be loaded).
+        // Every file has its own row (loading the same file again updates it), which is not shared with equal palettes.
+        // With @makeDefault it becomes palette of all meshes which have no own palette. Decoded files are cached by content.
+        //
+        std::shared_future<std::uint32_t> loadPaletteAsync(const char *fullPath, bool makeDefault = true);
+        
+        void setDefaultPalette(std::uint32_t row);
+        
+        // Watches model.vox, model.info and model.cooked of loaded meshes and palette files of loadPaletteAsync.
+        // Changed mesh is reparsed on worker thread and uploaded within the budget of asynchronous loading, then every mesh
+        // using it is switched at the start of updateAndDraw: transform stays, animations go on if their names still exist.
+        // Changed palette file rewrites its row. Replaced embedded palette of mesh frees its row unless other resources
+        // or addPalette use the same colors. Linux uses inotify, other platforms poll modification times.
+        // Meshes read voxels mapped from model.cooked until they are switched, so it must be replaced by rename as
+        // cookModel does, never rewritten in place.
+        //
+        void setHotReload(bool enabled);
+        
         void updateAndDraw(float dtSec);
+        
+        // Draws instances of voxel::Voxel layout (reserved field is zero) with shader and palette atlas of meshes,
+        // so other voxel volumes (VoxelWorld) share their state. Colors come from @paletteRow like VoxelMesh::setPalette.
+        //
+        void drawVoxels(const std::shared_ptr<platform::StructuredData> &voxels, std::uint32_t voxelCount, const math::transform3f &fullTransform, std::uint32_t paletteRow);
+        
+        // Meshes farther than @distance from camera are not drawn. Frustum culling is always on.
+        //
+        void setDrawDistance(float distance);
+        
+        // Meshes farther than @distances[i] from camera are drawn with level of detail i + 1 (see model.info lod_levels).
+        // Default distances are 100, 200 and 400. Empty vector keeps full detail at any distance.
+        //
+        void setLodDistances(const std::vector<float> &distances);
+        
+        struct PickResult {
+            std::shared_ptr<VoxelMesh> mesh;
+            math::vector3f position;  // world space hit point
+            math::vector3f normal;    // world space normal of hit face, zero if ray starts inside voxel
+            float distance;           // along ray in units of direction
+            std::int32_t voxelX, voxelY, voxelZ; // hit voxel in mesh space
+            std::uint8_t colorIndex;
+        };
+        
+        // Finds the closest voxel hit by ray among all meshes in their current frames at full detail.
+        // Voxels of every frame are put into sparse brick grid on the first query and traversed with DDA.
+        // Use Camera::screenToWorld for the ray of a touch: origin is camera position, direction is toward returned point.
+        //
+        bool pick(const math::vector3f &origin, const math::vector3f &direction, PickResult &result);
+        
+        struct Statistics {
+            // Last updateAndDraw
+            std::uint32_t meshesUpdated = 0;
+            std::uint32_t meshesDrawn = 0;
+            std::uint32_t meshesCulled = 0;
+            std::uint32_t drawCalls = 0;
+            std::uint32_t instancesSubmitted = 0; // voxels and faces
+            std::uint32_t verticesSubmitted = 0;
+            std::uint32_t frameSwitches = 0;
+            float animationTimeMs = 0.0f;
+            float submissionTimeMs = 0.0f;
+            
+            // Since creation: meshes loaded from files and time spent on reading, parsing and uploading them
+            std::uint32_t meshesLoaded = 0;
+            std::uint32_t meshesReloaded = 0;
+            float loadTimeMs = 0.0f;
+            std::uint32_t paletteRows = 0;
+            
+            // GPU buffers of currently loaded meshes
+            std::size_t gpuBytes = 0;
+        };
+        
+        Statistics getStatistics() const;
+        
+        // Records phases of updateAndDraw and mesh loading while enabled.
+        // writeTrace saves recorded events as Chrome trace JSON (chrome://tracing, Perfetto) and clears them.
+        //
+        void setTracing(bool enabled);
+        bool writeTrace(const char *fullPath);
 
     protected:
         VoxelMeshes() = default;
@@ -32,6 +163,7 @@ namespace voxel {
     std::shared_ptr<VoxelMeshes> makeVoxelMeshes(
         const std::shared_ptr<platform::Platform> &platform,
         const std::shared_ptr<platform::RenderingDevice> &renderingDevice,
-        const std::shared_ptr<platform::Texture2D> &palette
+        const std::shared_ptr<Camera> &camera,
+        const std::vector<std::uint8_t> &palette // default palette, RGBA of decodePalette, white if empty
     );
 }
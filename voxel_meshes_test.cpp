@@ -0,0 +1,694 @@
+// Headless tests of VoxelMeshes, exit code is the count of failed checks:
+// - concurrent loading: many folders are requested asynchronously at once, some of them several times and some of them
+//   also synchronously while their asynchronous loading is in flight. Every folder must be parsed once and all meshes
+//   of a folder must share its resource.
+// - re-cooking: model.cooked of a drawn mesh is cooked again with other voxels. Mesh must keep drawing voxels mapped
+//   from the previous file until hot reload switches it to the new one.
+// - hot reload: model.vox, model.info and model.cooked of a moved and animated mesh are changed one by one. Every change
+//   must switch the mesh to reloaded data, keeping its transform and its animation while the animation name exists.
+// - picking: rays along every cell column of the knight and of its scaled copy are compared with the first filled cell
+//   of voxels parsed from model.vox: hit voxel, color, position, normal, distance and the closest of both meshes.
+// - screen rays: Camera::screenToWorld and worldToScreen of a known camera give the view axis, the edges of field of
+//   view and each other's inverse, and the ray through the screen point of a picked voxel hits the same voxel.
+// - animation: updates of fixed dt must show the frames of loop, ping-pong and once playbacks at given speeds, play
+//   queued animations in order, and call finish callbacks in order at their ends but never for replaced animations.
+//
+// Usage: voxel_meshes_test [folder for model copies], run from repository root (data/knight is copied)
+// Build like voxel_benchmark.cpp:
+//   g++ -std=c++17 -O2 -I<include path> voxel_meshes_test.cpp voxel_meshes.cpp voxel_utility.cpp voxel_kernels.cpp voxel_bricks.cpp voxel_palettes.cpp -lpthread
+//
+#include "headless_platform.h"
+#include "voxel_meshes.h"
+#include "voxel_utility.h"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const std::size_t FOLDER_COUNT = 64;
+    const std::size_t REQUESTS_PER_FOLDER = 3;
+    const std::chrono::seconds TIMEOUT = std::chrono::seconds(30);
+    const float EPSILON = 1e-3f;
+    const float ANIMATION_DT = 1.0f / 16.0f; // half of walk frame, sums of it are exact
+
+    int failures = 0;
+
+    void check(bool condition, const char *description) {
+        if (condition == false) {
+            printf("FAILED: %s\n", description);
+            failures++;
+        }
+    }
+
+    template<typename T> bool isReady(const std::shared_future<T> &future) {
+        return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    std::string copyKnight(const std::filesystem::path &folder) {
+        std::filesystem::create_directories(folder);
+        std::filesystem::copy("data/knight", folder, std::filesystem::copy_options::recursive);
+        return folder.string();
+    }
+
+    // Knight stands at origin and is 12 units tall
+    //
+    std::shared_ptr<Camera> makeCamera(const std::shared_ptr<HeadlessPlatform> &platform) {
+        std::shared_ptr<Camera> camera = std::make_shared<Camera>(platform);
+        camera->setPerspectiveProj(50.0f, 0.1f, 1000.0f);
+        camera->setLookAtByRight(math::vector3f(0, 6, 40), math::vector3f(0, 6, 0), math::vector3f(1, 0, 0));
+        return camera;
+    }
+
+    void drawFrame(HeadlessRenderingDevice &renderingDevice, voxel::VoxelMeshes &meshes, float dtSec = 1.0f / 60.0f) {
+        renderingDevice.prepareFrame();
+        meshes.updateAndDraw(dtSec);
+    }
+
+    // Draws frames until @condition is true, returns false on timeout
+    //
+    bool drawUntil(HeadlessRenderingDevice &renderingDevice, voxel::VoxelMeshes &meshes, const std::function<bool()> &condition) {
+        auto start = std::chrono::steady_clock::now();
+
+        while (condition() == false) {
+            if (std::chrono::steady_clock::now() - start > TIMEOUT) {
+                return false;
+            }
+
+            drawFrame(renderingDevice, meshes);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return true;
+    }
+
+    // Instance data of all draws since the last prepareFrame, device must keep data
+    //
+    std::vector<std::uint8_t> getFrameInstances(const HeadlessRenderingDevice &renderingDevice) {
+        std::vector<std::uint8_t> result;
+
+        for (const HeadlessRenderingDevice::Draw &draw : renderingDevice.getFrameDraws()) {
+            const std::vector<std::uint8_t> &bytes = static_cast<const HeadlessRenderingDevice::Data &>(*draw.instanceData).getBytes();
+            result.insert(result.end(), bytes.begin(), bytes.end());
+        }
+
+        return result;
+    }
+
+    void testConcurrentLoading(const std::filesystem::path &root) {
+        std::vector<std::string> folders;
+
+        for (std::size_t i = 0; i < FOLDER_COUNT; i++) {
+            folders.emplace_back(copyKnight(root / ("knight" + std::to_string(i))));
+        }
+
+        std::shared_ptr<HeadlessPlatform> platform = std::make_shared<HeadlessPlatform>();
+        std::shared_ptr<HeadlessRenderingDevice> renderingDevice = std::make_shared<HeadlessRenderingDevice>();
+        std::shared_ptr<voxel::VoxelMeshes> meshes = voxel::makeVoxelMeshes(platform, renderingDevice, std::make_shared<Camera>(platform), {});
+
+        std::vector<std::shared_future<std::shared_ptr<voxel::VoxelMesh>>> futures;
+        std::vector<std::shared_ptr<voxel::VoxelMesh>> syncMeshes;
+        std::size_t completions = 0;
+
+        platform->setMessagesMuted(true);
+
+        for (std::size_t k = 0; k < REQUESTS_PER_FOLDER; k++) {
+            for (const std::string &folder : folders) {
+                futures.emplace_back(meshes->loadMeshAsync(folder.data(), [&](const std::shared_ptr<voxel::VoxelMesh> &mesh) {
+                    completions += mesh != nullptr;
+                }));
+            }
+        }
+
+        // synchronous loads join asynchronous ones in flight
+        for (std::size_t i = 0; i < FOLDER_COUNT; i += 8) {
+            syncMeshes.emplace_back(meshes->loadMesh(folders[i].data()));
+            check(syncMeshes.back() != nullptr, "loadMesh during loadMeshAsync of the same folder returns mesh");
+        }
+
+        auto missing = meshes->loadMeshAsync((root / "missing").string().data());
+        auto palette = meshes->loadPaletteAsync("data/palette.png");
+
+        bool ready = drawUntil(*renderingDevice, *meshes, [&]() {
+            bool result = isReady(missing) && isReady(palette);
+
+            for (auto &future : futures) {
+                result = result && isReady(future);
+            }
+
+            return result;
+        });
+
+        check(ready, "all loadings are finished in time");
+
+        if (ready) {
+            voxel::VoxelMeshes::Statistics statistics = meshes->getStatistics();
+
+            for (auto &future : futures) {
+                check(future.get() != nullptr, "every request of existing folder gets mesh");
+            }
+            for (std::size_t i = 0; i < FOLDER_COUNT; i++) {
+                for (std::size_t k = 1; k < REQUESTS_PER_FOLDER; k++) {
+                    const std::shared_ptr<voxel::VoxelMesh> &first = futures[i].get();
+                    const std::shared_ptr<voxel::VoxelMesh> &other = futures[k * FOLDER_COUNT + i].get();
+                    check(first != other, "every request gets own mesh");
+                }
+            }
+
+            check(completions == futures.size(), "every completion is called once with mesh");
+            check(missing.get() == nullptr, "missing folder gives nullptr");
+            check(statistics.meshesLoaded == FOLDER_COUNT, "every folder is parsed and uploaded once");
+            check(statistics.gpuBytes == syncMeshes[0]->getGpuBytes() * FOLDER_COUNT, "meshes of the same folder share GPU buffers");
+            check(platform->getErrorCount() == 1, "only missing folder is reported");
+        }
+    }
+
+    // cookModel replaces model.cooked by rename, so voxels which are mapped from the previous file stay readable
+    //
+    void testRecooking(const std::filesystem::path &root) {
+        std::string folder = copyKnight(root / "recooked");
+        std::string cookedPath = folder + "/model.cooked";
+
+        std::shared_ptr<HeadlessPlatform> platform = std::make_shared<HeadlessPlatform>();
+        std::shared_ptr<HeadlessRenderingDevice> renderingDevice = std::make_shared<HeadlessRenderingDevice>();
+        std::shared_ptr<voxel::VoxelMeshes> meshes = voxel::makeVoxelMeshes(platform, renderingDevice, makeCamera(platform), {});
+
+        platform->setMessagesMuted(true);
+        renderingDevice->setKeepData(true);
+        check(voxel::cookMesh(platform, folder.data()), "knight is cooked");
+
+        std::shared_ptr<voxel::VoxelMesh> mesh = meshes->loadMesh(folder.data());
+        check(mesh != nullptr, "cooked knight is loaded");
+
+        if (mesh == nullptr) {
+            return;
+        }
+
+        meshes->setHotReload(true);
+        drawFrame(*renderingDevice, *meshes);
+        std::vector<std::uint8_t> mapped = getFrameInstances(*renderingDevice);
+        check(mapped.size() != 0, "cooked knight is drawn");
+
+        // smaller model with other colors, so old file contents can't survive overwriting in place
+        voxel::ModelInfo info;
+        voxel::Model model;
+        check(voxel::loadModelInfo(platform, (folder + "/model.info").data(), info), "model.info is loaded");
+        check(voxel::loadModel(platform, (folder + "/model.vox").data(), voxel::makeModelOptions(info), model), "model.vox is loaded");
+
+        for (voxel::Frame &frame : model.frames) {
+            frame.voxels.resize(frame.voxels.size() / 2);
+
+            for (voxel::Voxel &voxel : frame.voxels) {
+                voxel.colorIndex ^= 1;
+            }
+        }
+
+        check(voxel::cookModel(platform, cookedPath.data(), model, info), "knight is cooked again");
+        check(std::filesystem::exists(cookedPath + ".tmp") == false, "temporary file is renamed");
+
+        drawFrame(*renderingDevice, *meshes);
+        check(getFrameInstances(*renderingDevice) == mapped, "mesh draws voxels of previous file until reload");
+
+        bool reloaded = drawUntil(*renderingDevice, *meshes, [&]() {
+            return meshes->getStatistics().meshesReloaded != 0;
+        });
+
+        check(reloaded, "re-cooked knight is reloaded in time");
+
+        if (reloaded) {
+            drawFrame(*renderingDevice, *meshes);
+            std::vector<std::uint8_t> recooked = getFrameInstances(*renderingDevice);
+            check(recooked.size() != 0 && recooked.size() < mapped.size(), "mesh draws voxels of re-cooked file after reload");
+        }
+
+        check(platform->getErrorCount() == 0, "re-cooking reports no errors");
+    }
+
+    void writeFile(const std::string &path, const std::string &content) {
+        std::ofstream file (path, std::ios::binary | std::ios::trunc);
+        file << content;
+    }
+
+    std::string readFile(const std::string &path) {
+        std::ifstream file (path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // Frame switches of animations during @frameCount frames
+    //
+    std::uint32_t countFrameSwitches(HeadlessRenderingDevice &renderingDevice, voxel::VoxelMeshes &meshes, std::size_t frameCount) {
+        std::uint32_t result = 0;
+
+        for (std::size_t i = 0; i < frameCount; i++) {
+            drawFrame(renderingDevice, meshes);
+            result += meshes.getStatistics().frameSwitches;
+        }
+
+        return result;
+    }
+
+    bool isNear(const math::vector3f &a, const math::vector3f &b, float epsilon = EPSILON) {
+        return std::abs(a.x - b.x) < epsilon && std::abs(a.y - b.y) < epsilon && std::abs(a.z - b.z) < epsilon;
+    }
+
+    // Color of every filled cell of the frame, cell (x, y, z) is the unit cube centered at (x, y, z) in mesh space
+    //
+    std::map<std::array<int, 3>, std::uint8_t> getCells(const voxel::Model &model, std::size_t frameIndex) {
+        std::map<std::array<int, 3>, std::uint8_t> result;
+
+        for (const std::vector<voxel::Voxel> *voxels : {&model.base.voxels, &model.frames[frameIndex].voxels}) {
+            for (const voxel::Voxel &v : *voxels) {
+                for (int z = v.positionZ; z < v.positionZ + v.scaleZ; z++) {
+                    for (int y = v.positionY; y < v.positionY + v.scaleY; y++) {
+                        for (int x = v.positionX; x < v.positionX + v.scaleX; x++) {
+                            result[{x, y, z}] = v.colorIndex;
+                        }
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // Highest filled z of every (x, y) column
+    //
+    std::map<std::array<int, 2>, int> getColumnTops(const std::map<std::array<int, 3>, std::uint8_t> &cells) {
+        std::map<std::array<int, 2>, int> result;
+
+        for (const auto &cell : cells) {
+            const std::array<int, 3> &c = cell.first;
+            auto top = result.emplace(std::array<int, 2> {c[0], c[1]}, c[2]).first;
+            top->second = std::max(top->second, c[2]);
+        }
+
+        return result;
+    }
+
+    void testPicking(const std::filesystem::path &root) {
+        const float SCALE = 2.0f;
+        const float START_Z = 40.0f;
+        const math::vector3f SCALED_AT = math::vector3f(100, 0, 0);
+
+        std::string folder = copyKnight(root / "picked");
+        std::shared_ptr<HeadlessPlatform> platform = std::make_shared<HeadlessPlatform>();
+        std::shared_ptr<HeadlessRenderingDevice> renderingDevice = std::make_shared<HeadlessRenderingDevice>();
+        std::shared_ptr<voxel::VoxelMeshes> meshes = voxel::makeVoxelMeshes(platform, renderingDevice, makeCamera(platform), {});
+
+        platform->setMessagesMuted(true);
+
+        voxel::ModelInfo info;
+        voxel::Model model;
+        check(voxel::loadModelInfo(platform, (folder + "/model.info").data(), info), "model.info is loaded");
+        check(voxel::loadModel(platform, (folder + "/model.vox").data(), voxel::makeModelOptions(info), model), "model.vox is loaded");
+
+        std::shared_ptr<voxel::VoxelMesh> mesh = meshes->loadMesh(folder.data());
+        std::shared_ptr<voxel::VoxelMesh> scaled = meshes->loadMesh(folder.data());
+        check(mesh != nullptr && scaled != nullptr, "knight is loaded twice");
+
+        if (mesh == nullptr || scaled == nullptr || model.frames.empty()) {
+            return;
+        }
+
+        // the copy is scaled around its origin and moved aside, nothing plays, so both meshes show frame 0
+        math::transform3f transform = math::transform3f::identity();
+        transform.flat16[0] = transform.flat16[5] = transform.flat16[10] = SCALE;
+        transform.flat16[12] = SCALED_AT.x;
+        transform.flat16[13] = SCALED_AT.y;
+        transform.flat16[14] = SCALED_AT.z;
+        scaled->setTransform(transform);
+
+        std::map<std::array<int, 3>, std::uint8_t> cells = getCells(model, 0);
+        std::map<std::array<int, 2>, int> columnTops = getColumnTops(cells);
+        int minX = 0, maxX = 0, minY = 0, maxY = 0;
+
+        for (const auto &cell : cells) {
+            const std::array<int, 3> &c = cell.first;
+            minX = std::min(minX, c[0]);
+            maxX = std::max(maxX, c[0]);
+            minY = std::min(minY, c[1]);
+            maxY = std::max(maxY, c[1]);
+        }
+
+        check(cells.size() != 0, "knight has filled cells");
+
+        // direction of twice the unit length halves distances, rays hit cells off their centers
+        int mismatches = 0;
+
+        for (int y = minY - 1; y <= maxY + 1; y++) {
+            for (int x = minX - 1; x <= maxX + 1; x++) {
+                auto top = columnTops.find({x, y});
+
+                for (float scale : {1.0f, SCALE}) {
+                    math::vector3f offset = scale == 1.0f ? math::vector3f(0, 0, 0) : SCALED_AT;
+                    math::vector3f origin = offset + math::vector3f(x + 0.2f, y - 0.3f, 0) * scale + math::vector3f(0, 0, START_Z);
+                    voxel::VoxelMeshes::PickResult hit;
+                    bool found = meshes->pick(origin, math::vector3f(0, 0, -2), hit);
+
+                    if (top == columnTops.end()) {
+                        mismatches += found;
+                        continue;
+                    }
+
+                    float hitZ = (top->second + 0.5f) * scale + offset.z;
+                    mismatches += found == false ||
+                        hit.mesh != (scale == 1.0f ? mesh : scaled) ||
+                        hit.voxelX != x || hit.voxelY != y || hit.voxelZ != top->second ||
+                        hit.colorIndex != cells[{x, y, top->second}] ||
+                        isNear(hit.position, math::vector3f(origin.x, origin.y, hitZ)) == false ||
+                        isNear(hit.normal, math::vector3f(0, 0, 1)) == false ||
+                        std::abs(hit.distance - (START_Z - hitZ) / 2.0f) > EPSILON;
+                }
+            }
+        }
+
+        check(mismatches == 0, "every column ray hits its top cell of the right mesh with position, normal and distance");
+
+        // ray along +X through the lowest filled cell of its row hits its -X face
+        const std::array<int, 3> &first = cells.begin()->first;
+        int leftX = first[0];
+
+        for (const auto &cell : cells) {
+            if (cell.first[1] == first[1] && cell.first[2] == first[2]) {
+                leftX = std::min(leftX, cell.first[0]);
+            }
+        }
+
+        voxel::VoxelMeshes::PickResult side;
+        math::vector3f sideOrigin = math::vector3f(minX - 10.0f, first[1] + 0.1f, first[2] - 0.1f);
+        check(meshes->pick(sideOrigin, math::vector3f(1, 0, 0), side) && side.mesh == mesh, "side ray hits mesh");
+        check(side.voxelX == leftX && side.voxelY == first[1] && side.voxelZ == first[2], "side ray hits the first cell of its row");
+        check(isNear(side.normal, math::vector3f(-1, 0, 0)), "side ray hits -X face");
+        check(std::abs(side.distance - (leftX - 0.5f - sideOrigin.x)) < EPSILON, "side ray distance is in units of direction");
+
+        // meshes in front of each other: the closest one along the ray wins whichever is registered first
+        auto top = columnTops.begin();
+        math::vector3f through = math::vector3f(top->first[0] + 0.2f, top->first[1] - 0.3f, START_Z);
+        voxel::VoxelMeshes::PickResult closest;
+        transform = math::transform3f::identity();
+        transform.flat16[14] = 20.0f;
+        scaled->setTransform(transform);
+        check(meshes->pick(through, math::vector3f(0, 0, -1), closest) && closest.mesh == scaled, "mesh in front is picked");
+        check(std::abs(closest.distance - (START_Z - 20.0f - top->second - 0.5f)) < EPSILON, "distance is to the mesh in front");
+
+        transform.flat16[14] = -20.0f;
+        scaled->setTransform(transform);
+        check(meshes->pick(through, math::vector3f(0, 0, -1), closest) && closest.mesh == mesh, "mesh behind is not picked");
+
+        // ray starting inside a filled cell hits it at once without face
+        voxel::VoxelMeshes::PickResult inside;
+        math::vector3f center = math::vector3f(float(first[0]), float(first[1]), float(first[2]));
+        check(meshes->pick(center, math::vector3f(0, 0, -1), inside) && inside.mesh == mesh, "ray from inside of voxel hits mesh");
+        check(inside.voxelX == first[0] && inside.voxelY == first[1] && inside.voxelZ == first[2], "ray from inside of voxel hits that voxel");
+        check(inside.distance < EPSILON && isNear(inside.normal, math::vector3f(0, 0, 0)), "ray from inside of voxel has zero distance and normal");
+
+        voxel::VoxelMeshes::PickResult miss;
+        check(meshes->pick(math::vector3f(0, 1000, START_Z), math::vector3f(0, 0, -1), miss) == false, "ray above meshes misses");
+        check(meshes->pick(math::vector3f(through.x, through.y, -START_Z - 100.0f), math::vector3f(0, 0, -1), miss) == false, "meshes behind ray origin are not picked");
+        check(platform->getErrorCount() == 0, "picking reports no errors");
+    }
+
+    // Camera of makeCamera looks along -Z from (0, 6, 40), its vertical field of view is 50 degrees
+    //
+    void testScreenRays(const std::filesystem::path &root) {
+        std::string folder = copyKnight(root / "screen");
+        std::shared_ptr<HeadlessPlatform> platform = std::make_shared<HeadlessPlatform>(1280.0f, 720.0f);
+        std::shared_ptr<HeadlessRenderingDevice> renderingDevice = std::make_shared<HeadlessRenderingDevice>();
+        std::shared_ptr<Camera> camera = makeCamera(platform);
+        std::shared_ptr<voxel::VoxelMeshes> meshes = voxel::makeVoxelMeshes(platform, renderingDevice, camera, {});
+
+        float w = platform->getNativeScreenWidth(), h = platform->getNativeScreenHeight();
+        float halfHeight = 40.0f * std::tan(25.0f / 180.0f * 3.14159265f); // of view at z = 0
+        float halfWidth = halfHeight * w / h;
+
+        // far plane point is unprojected with float precision of depth, so its direction is checked tighter than its distance
+        math::vector3f center = camera->screenToWorld(math::vector2f(w / 2, h / 2)) - camera->getPosition();
+        check(isNear(center.normalized(), math::vector3f(0, 0, -1)), "screen center is on view axis");
+        check(std::abs(center.length() / camera->getZFar() - 1.0f) < 0.01f, "screen points are at far plane");
+
+        math::vector2f onAxis = camera->worldToScreen(math::vector3f(0, 6, 0));
+        math::vector2f topLeft = camera->worldToScreen(math::vector3f(-halfWidth, 6 + halfHeight, 0));
+        math::vector2f bottomRight = camera->worldToScreen(math::vector3f(halfWidth, 6 - halfHeight, 0));
+        check(std::abs(onAxis.x - w / 2) < 0.01f && std::abs(onAxis.y - h / 2) < 0.01f, "view axis is at screen center");
+        check(std::abs(topLeft.x) < 0.05f && std::abs(topLeft.y) < 0.05f, "top left of field of view is at screen origin");
+        check(std::abs(bottomRight.x - w) < 0.05f && std::abs(bottomRight.y - h) < 0.05f, "bottom right of field of view is at screen size");
+
+        int mismatches = 0;
+
+        for (float y = 0.0f; y <= h; y += h / 8) {
+            for (float x = 0.0f; x <= w; x += w / 8) {
+                math::vector2f screen = camera->worldToScreen(camera->screenToWorld(math::vector2f(x, y)));
+                mismatches += std::abs(screen.x - x) > 0.05f || std::abs(screen.y - y) > 0.05f;
+            }
+        }
+
+        check(mismatches == 0, "worldToScreen is inverse of screenToWorld");
+
+        platform->setMessagesMuted(true);
+        std::shared_ptr<voxel::VoxelMesh> mesh = meshes->loadMesh(folder.data());
+        check(mesh != nullptr, "knight is loaded");
+
+        if (mesh == nullptr) {
+            return;
+        }
+
+        // touch of the screen point of a picked voxel picks it again
+        voxel::VoxelMeshes::PickResult hit;
+        voxel::VoxelMeshes::PickResult touched;
+        check(meshes->pick(camera->getPosition(), math::vector3f(0.02f, 0, -1), hit), "knight is picked from camera");
+
+        math::vector2f screen = camera->worldToScreen(hit.position);
+        math::vector3f direction = camera->screenToWorld(screen) - camera->getPosition();
+        check(meshes->pick(camera->getPosition(), direction, touched), "knight is picked through screen");
+        check(touched.voxelX == hit.voxelX && touched.voxelY == hit.voxelY && touched.voxelZ == hit.voxelZ, "screen ray hits the same voxel");
+        check(isNear(camera->getPosition() + direction * touched.distance, hit.position, 0.01f), "screen ray hits the same point");
+        check(platform->getErrorCount() == 0, "screen rays report no errors");
+    }
+
+    // Frame shown by the only mesh, found by picking every column of all frames along -Z. Column tops of knight frames
+    // all differ. Returns -1 if picked columns match no frame.
+    //
+    int getShownFrame(voxel::VoxelMeshes &meshes, const std::vector<std::map<std::array<int, 2>, int>> &frameTops) {
+        for (std::size_t k = 0; k < frameTops.size(); k++) {
+            bool matches = true;
+
+            for (const std::map<std::array<int, 2>, int> &tops : frameTops) {
+                for (const auto &column : tops) {
+                    voxel::VoxelMeshes::PickResult hit;
+                    bool found = meshes.pick(math::vector3f(column.first[0] + 0.2f, column.first[1] - 0.3f, 40.0f), math::vector3f(0, 0, -1), hit);
+                    auto top = frameTops[k].find(column.first);
+                    matches = matches && (top == frameTops[k].end() ? found == false : found && hit.voxelZ == top->second);
+                }
+            }
+            if (matches) {
+                return int(k);
+            }
+        }
+
+        return -1;
+    }
+
+    // Every updateAndDraw advances animations by the same dt, so frames and finish callbacks follow exactly from the
+    // frame rate of walk (frames 0 - 4 at 8 frames per second), playback and speed
+    //
+    void testAnimation(const std::filesystem::path &root) {
+        std::string folder = copyKnight(root / "animated");
+        std::shared_ptr<HeadlessPlatform> platform = std::make_shared<HeadlessPlatform>();
+        std::shared_ptr<HeadlessRenderingDevice> renderingDevice = std::make_shared<HeadlessRenderingDevice>();
+        std::shared_ptr<voxel::VoxelMeshes> meshes = voxel::makeVoxelMeshes(platform, renderingDevice, makeCamera(platform), {});
+
+        platform->setMessagesMuted(true);
+
+        voxel::ModelInfo info;
+        voxel::Model model;
+        check(voxel::loadModelInfo(platform, (folder + "/model.info").data(), info), "model.info is loaded");
+        check(voxel::loadModel(platform, (folder + "/model.vox").data(), voxel::makeModelOptions(info), model), "model.vox is loaded");
+
+        std::shared_ptr<voxel::VoxelMesh> mesh = meshes->loadMesh(folder.data());
+        check(mesh != nullptr && model.frames.size() == 5, "knight with 5 frames is loaded");
+
+        if (mesh == nullptr || model.frames.size() != 5) {
+            return;
+        }
+
+        std::vector<std::map<std::array<int, 2>, int>> frameTops;
+
+        for (std::size_t k = 0; k < model.frames.size(); k++) {
+            frameTops.emplace_back(getColumnTops(getCells(model, k)));
+        }
+
+        // finish callbacks record their name and the step which called them
+        std::vector<std::string> events;
+        std::size_t step = 0;
+
+        auto finished = [&](const char *name) {
+            return [&, name](voxel::VoxelMesh &finishedMesh) {
+                check(&finishedMesh == mesh.get(), "finish callback gets its mesh");
+                events.emplace_back(std::string(name) + " " + std::to_string(step));
+            };
+        };
+
+        // frames shown after each of @count updates
+        auto run = [&](std::size_t count, float dtSec = ANIMATION_DT) {
+            std::vector<int> result;
+
+            for (std::size_t i = 0; i < count; i++) {
+                step++;
+                drawFrame(*renderingDevice, *meshes, dtSec);
+                result.emplace_back(getShownFrame(*meshes, frameTops));
+            }
+
+            return result;
+        };
+
+        // restarts step count for callbacks of the next case
+        auto play = [&](const char *name, voxel::VoxelMesh::Playback playback, float speed, std::function<void(voxel::VoxelMesh&)> &&callback) {
+            step = 0;
+            events.clear();
+            mesh->playAnimation(name, playback, speed, std::move(callback));
+        };
+
+        using Playback = voxel::VoxelMesh::Playback;
+
+        check(run(2) == std::vector<int> {0, 0}, "mesh shows frame 0 when nothing is playing");
+
+        play("walk", Playback::LOOP, 1.0f, finished("loop"));
+        check(run(12) == std::vector<int> {0, 1, 1, 2, 2, 3, 3, 4, 4, 0, 0, 1}, "loop switches frame every 1/8 second and wraps");
+        check(events.empty(), "looping animation doesn't finish");
+
+        play("walk", Playback::LOOP, 2.0f, nullptr);
+        check(run(7) == std::vector<int> {1, 2, 3, 4, 0, 1, 2}, "speed 2 switches frame every update");
+
+        play("walk", Playback::LOOP, 0.5f, nullptr);
+        check(run(8) == std::vector<int> {0, 0, 0, 1, 1, 1, 1, 2}, "speed 0.5 switches frame every 4 updates");
+
+        play("walk", Playback::PING_PONG, 2.0f, nullptr);
+        check(run(17) == std::vector<int> {1, 2, 3, 4, 3, 2, 1, 0, 1, 2, 3, 4, 3, 2, 1, 0, 1}, "ping-pong goes back without repeating end frames");
+
+        play("walk", Playback::ONCE, 1.0f, finished("once"));
+        check(run(12) == std::vector<int> {0, 1, 1, 2, 2, 3, 3, 4, 4, 0, 0, 0}, "animation played once ends with frame 0");
+        check(events == std::vector<std::string> {"once 10"}, "animation played once finishes once at its end");
+
+        mesh->queueAnimation("walk", Playback::LOOP, 2.0f, finished("started"));
+        check(run(2) == std::vector<int> {1, 2}, "queued animation starts at once when nothing is playing");
+
+        // leftover time of finished animation goes to the next one, callbacks follow queue order
+        play("walk", Playback::ONCE, 2.0f, finished("first"));
+        mesh->queueAnimation("walk", Playback::PING_PONG, 2.0f, finished("second"));
+        mesh->queueAnimation("walk", Playback::ONCE, 4.0f, finished("third"));
+        check(run(17) == std::vector<int> {1, 2, 3, 4, 0, 1, 2, 3, 4, 3, 2, 1, 0, 2, 4, 0, 0}, "queued animations follow each other with their playbacks and speeds");
+        check(events == std::vector<std::string> {"first 5", "second 13", "third 16"}, "queued animations finish in order at their ends");
+
+        // one long update finishes several animations, the last one gets time left after them
+        play("walk", Playback::ONCE, 1.0f, finished("first"));
+        mesh->queueAnimation("walk", Playback::ONCE, 1.0f, finished("second"));
+        mesh->queueAnimation("walk", Playback::ONCE, 1.0f, finished("third"));
+        mesh->queueAnimation("walk", Playback::LOOP, 1.0f, finished("loop"));
+        check(run(1, 3 * 5 * 2 * ANIMATION_DT + 4 * ANIMATION_DT) == std::vector<int> {2}, "long update skips to frame of the last queued animation");
+        check(events == std::vector<std::string> {"first 1", "second 1", "third 1"}, "animations finished by one update are called in order");
+
+        // replaced animations and their queues are never finished
+        play("walk", Playback::ONCE, 1.0f, finished("replaced"));
+        mesh->queueAnimation("walk", Playback::ONCE, 1.0f, finished("replaced queued"));
+        run(4);
+        mesh->playAnimation("walk", Playback::ONCE, 1.0f, finished("replacing"));
+        check(run(12) == std::vector<int> {0, 1, 1, 2, 2, 3, 3, 4, 4, 0, 0, 0}, "replacing animation starts from its first frame");
+        check(events == std::vector<std::string> {"replacing 14"}, "finish is not called for replaced animations");
+
+        // callback may start next animation, which is shown from the next update
+        play("walk", Playback::ONCE, 2.0f, [&](voxel::VoxelMesh &finishedMesh) {
+            events.emplace_back("chained " + std::to_string(step));
+            finishedMesh.playAnimation("walk", Playback::ONCE, 2.0f, finished("chain end"));
+        });
+        check(run(12) == std::vector<int> {1, 2, 3, 4, 0, 1, 2, 3, 4, 0, 0, 0}, "animation played by callback runs to its end");
+        check(events == std::vector<std::string> {"chained 5", "chain end 10"}, "animation played by callback finishes after it");
+
+        check(platform->getErrorCount() == 0, "animations report no errors");
+    }
+
+    void testHotReload(const std::filesystem::path &root) {
+        const float MOVE_X = 100.0f;
+
+        std::string folder = copyKnight(root / "reloaded");
+        std::shared_ptr<HeadlessPlatform> platform = std::make_shared<HeadlessPlatform>();
+        std::shared_ptr<HeadlessRenderingDevice> renderingDevice = std::make_shared<HeadlessRenderingDevice>();
+        std::shared_ptr<voxel::VoxelMeshes> meshes = voxel::makeVoxelMeshes(platform, renderingDevice, makeCamera(platform), {});
+
+        platform->setMessagesMuted(true);
+        std::shared_ptr<voxel::VoxelMesh> mesh = meshes->loadMesh(folder.data());
+        check(mesh != nullptr, "knight is loaded");
+
+        if (mesh == nullptr) {
+            return;
+        }
+
+        math::transform3f transform = math::transform3f::identity();
+        transform.flat16[12] = MOVE_X;
+        mesh->setTransform(transform);
+        mesh->playAnimation("walk", voxel::VoxelMesh::Playback::LOOP);
+        meshes->setHotReload(true);
+
+        // mesh is hit through its transform only, animation keeps switching frames
+        auto checkMesh = [&](const char *isHit, const char *isAnimated, bool animated) {
+            voxel::VoxelMeshes::PickResult hit;
+            voxel::VoxelMeshes::PickResult miss;
+            bool hitFound = meshes->pick(math::vector3f(MOVE_X, 6, 40), math::vector3f(0, 0, -1), hit);
+            bool missFound = meshes->pick(math::vector3f(0, 6, 40), math::vector3f(0, 0, -1), miss);
+            check(hitFound && hit.mesh == mesh && missFound == false, isHit);
+            check((countFrameSwitches(*renderingDevice, *meshes, 60) != 0) == animated, isAnimated);
+        };
+
+        // every change is followed by one reload
+        auto waitReload = [&](std::uint32_t count, const char *description) {
+            check(drawUntil(*renderingDevice, *meshes, [&]() {
+                return meshes->getStatistics().meshesReloaded >= count;
+            }), description);
+            check(meshes->getStatistics().meshesReloaded == count, description);
+        };
+
+        checkMesh("loaded mesh is hit at its position", "loaded mesh is animated", true);
+
+        writeFile(folder + "/model.vox", readFile(folder + "/model.vox"));
+        waitReload(1, "changed model.vox is reloaded");
+        checkMesh("mesh keeps transform when model.vox is reloaded", "mesh keeps animation when model.vox is reloaded", true);
+
+        writeFile(folder + "/model.info", "animation = \"walk\" 0 4 16.0");
+        waitReload(2, "changed model.info is reloaded");
+        checkMesh("mesh keeps transform when model.info is reloaded", "mesh keeps animation when model.info is reloaded", true);
+
+        check(voxel::cookMesh(platform, folder.data()), "knight is cooked");
+        waitReload(3, "new model.cooked is reloaded");
+        checkMesh("mesh keeps transform when model.cooked is reloaded", "mesh keeps animation when model.cooked is reloaded", true);
+
+        writeFile(folder + "/model.info", "animation = \"run\" 0 4 16.0");
+        waitReload(4, "model.info with renamed animation is reloaded");
+        checkMesh("mesh keeps transform when its animation is renamed", "animation stops when its name is gone", false);
+
+        check(platform->getErrorCount() == 0, "hot reload reports no errors");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::filesystem::path root = argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::temp_directory_path() / "voxel_meshes_test";
+
+    std::filesystem::remove_all(root);
+    testConcurrentLoading(root);
+    testRecooking(root);
+    testHotReload(root);
+    testPicking(root);
+    testScreenRays(root);
+    testAnimation(root);
+
+    printf("%s: %d failed checks\n", argv[0], failures);
+    return failures;
+}
@@ -0,0 +1,86 @@
+#include "voxel_palettes.h"
+#include "voxel_utility.h"
+
+#include <cstring>
+
+namespace voxel {
+    bool PaletteAtlas::add(const std::uint8_t *rgba, std::uint32_t &row) {
+        std::uint64_t hash = hashContent(rgba, PALETTE_BYTES);
+        auto range = _rowsByHash.equal_range(hash);
+        
+        for (auto index = range.first; index != range.second; ++index) {
+            if (std::memcmp(&_rows[std::size_t(index->second) * PALETTE_BYTES], rgba, PALETTE_BYTES) == 0) {
+                row = index->second;
+                _references[row]++;
+                return true;
+            }
+        }
+        if (_allocate(rgba, row) == false) {
+            return false;
+        }
+        
+        _rowsByHash.emplace(hash, row);
+        return true;
+    }
+
+    bool PaletteAtlas::addPrivate(const std::uint8_t *rgba, std::uint32_t &row) {
+        return _allocate(rgba, row);
+    }
+
+    void PaletteAtlas::replace(std::uint32_t row, const std::uint8_t *rgba) {
+        std::memcpy(&_rows[std::size_t(row) * PALETTE_BYTES], rgba, PALETTE_BYTES);
+        _changed = true;
+    }
+
+    void PaletteAtlas::release(std::uint32_t row) {
+        if (--_references[row] == 0) {
+            std::uint8_t *colors = &_rows[std::size_t(row) * PALETTE_BYTES];
+            auto range = _rowsByHash.equal_range(hashContent(colors, PALETTE_BYTES));
+            
+            for (auto index = range.first; index != range.second; ++index) {
+                if (index->second == row) {
+                    _rowsByHash.erase(index);
+                    break;
+                }
+            }
+            
+            _freeRows.emplace_back(row);
+        }
+    }
+
+    const std::shared_ptr<platform::Texture2D> &PaletteAtlas::getTexture() {
+        if (_changed) {
+            // texture can't be updated in place, so it's recreated with rows padded up to capacity
+            std::vector<std::uint8_t> texels (_rows);
+            texels.resize(std::size_t(_capacity) * PALETTE_BYTES, 0);
+            _texture = _renderingDevice->createTexture(platform::Texture2D::Format::RGBA8UN, 256, _capacity, {texels.data()});
+            _changed = false;
+        }
+        
+        return _texture;
+    }
+
+    bool PaletteAtlas::_allocate(const std::uint8_t *rgba, std::uint32_t &row) {
+        if (_freeRows.size()) {
+            row = _freeRows.back();
+            _freeRows.pop_back();
+            std::memcpy(&_rows[std::size_t(row) * PALETTE_BYTES], rgba, PALETTE_BYTES);
+        }
+        else if (getRowCount() < MAX_ROWS) {
+            row = getRowCount();
+            _rows.insert(_rows.end(), rgba, rgba + PALETTE_BYTES);
+            _references.emplace_back(0);
+            
+            while (_capacity < getRowCount()) {
+                _capacity *= 2;
+            }
+        }
+        else {
+            return false;
+        }
+        
+        _references[row] = 1;
+        _changed = true;
+        return true;
+    }
+}
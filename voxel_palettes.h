@@ -0,0 +1,69 @@
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "utility/common.h"
+#include "platform/interfaces.h"
+
+namespace voxel {
+    // Palettes of 256 RGBA colors kept as rows of one texture, so meshes with different palettes share texture binding and batches.
+    // Palettes with equal colors share a row (rows are looked up by content hash), private rows are never shared.
+    // Rows are reference counted, row without references is reused by the next added palette. Row i is sampled at v = getRowTexcoord(i).
+    // Texture height is a power of two, it's recreated by getTexture after rows are changed. Rendering thread only.
+    //
+    class PaletteAtlas : public utility::NonCopyable, public utility::NonMovable {
+    public:
+        static constexpr std::uint32_t PALETTE_BYTES = 256 * 4;
+        static constexpr std::uint32_t MAX_ROWS = 256;
+        
+        PaletteAtlas(const std::shared_ptr<platform::RenderingDevice> &renderingDevice) : _renderingDevice(renderingDevice) {}
+        
+        // Finds or adds shared row with colors of @rgba (PALETTE_BYTES) and takes reference to it. Returns false if atlas is full.
+        //
+        bool add(const std::uint8_t *rgba, std::uint32_t &row);
+        
+        // Adds row which is never returned by add, so its colors may be replaced without touching other palettes
+        //
+        bool addPrivate(const std::uint8_t *rgba, std::uint32_t &row);
+        
+        // Rewrites colors of private @row, every user of the row gets new colors
+        //
+        void replace(std::uint32_t row, const std::uint8_t *rgba);
+        
+        // Drops reference taken by add or addPrivate
+        //
+        void release(std::uint32_t row);
+        
+        std::uint32_t getRowCount() const {
+            return std::uint32_t(_rows.size() / PALETTE_BYTES);
+        }
+        
+        float getRowTexcoord(std::uint32_t row) const {
+            return (float(row) + 0.5f) / float(_capacity);
+        }
+        
+        // nullptr if atlas is empty or texture can't be created
+        //
+        const std::shared_ptr<platform::Texture2D> &getTexture();
+        
+        std::size_t getGpuBytes() const {
+            return _texture ? std::size_t(_capacity) * PALETTE_BYTES : 0;
+        }
+
+    private:
+        std::shared_ptr<platform::RenderingDevice> _renderingDevice;
+        std::shared_ptr<platform::Texture2D> _texture;
+        std::vector<std::uint8_t> _rows;
+        std::unordered_multimap<std::uint64_t, std::uint32_t> _rowsByHash; // shared rows only
+        std::vector<std::uint32_t> _references; // per row
+        std::vector<std::uint32_t> _freeRows;
+        std::uint32_t _capacity = 1;
+        bool _changed = false;
+        
+        bool _allocate(const std::uint8_t *rgba, std::uint32_t &row);
+    };
+}
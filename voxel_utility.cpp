@@ -1,5 +1,8 @@
 
 #include "voxel_utility.h"
+#include "voxel_kernels.h"
+#include "utility/common.h"
+#include "arena.h"
 
 namespace lib {
 #include "lib/upng.h"
@@ -7,100 +10,1144 @@ namespace lib {
 }
 
 #include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <istream>
+#include <streambuf>
 
-namespace voxel {
-    std::vector<Frame> loadModel(const std::shared_ptr<platform::Platform> &platform, const char *fullPath, const math::vector3f &offset) {
-        const std::int32_t version = 150;
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-        std::vector<Frame> result;
-        std::unique_ptr<std::uint8_t []> voxData;
-        std::size_t voxSize = 0;
+namespace {
+    std::int32_t readInt32(const std::uint8_t *data) {
+        std::int32_t result;
+        memcpy(&result, data, sizeof(std::int32_t));
+        return result;
+    }
+    
+    struct VoxChunk {
+        char id[4];
+        const std::uint8_t *content;
+        std::uint32_t contentSize;
+        const std::uint8_t *children;
+        std::uint32_t childrenSize;
+    };
+    
+    // Walks sibling chunks in [begin, end). Every declared size is checked against the range,
+    // iteration stops at the first chunk which doesn't fit.
+    //
+    class VoxChunkIterator {
+    public:
+        VoxChunkIterator(const std::uint8_t *begin, const std::uint8_t *end) : _current(begin), _end(end) {}
         
-        if (platform->loadFile(fullPath, voxData, voxSize)) {
-            std::uint8_t *data = voxData.get();
+        bool next(VoxChunk &chunk) {
+            if (_malformed || _current == _end) {
+                return false;
+            }
+            if (std::size_t(_end - _current) < 12) {
+                _malformed = true;
+                return false;
+            }
             
-            if (memcmp(data, "VOX ", 4) == 0 && *(std::int32_t *)(data + 4) == version) {
-                // skip bytes of main chunk to start of the first child ('PACK')
-                data += 20;
-                
-                if (memcmp(data, "PACK", 4) == 0) {
-                    std::int32_t modelCount = *(std::int32_t *)(data + 12);
-                    
-                    data += 16;
-                    result.resize(modelCount);
+            std::uint32_t contentSize = std::uint32_t(readInt32(_current + 4));
+            std::uint32_t childrenSize = std::uint32_t(readInt32(_current + 8));
+            std::size_t available = std::size_t(_end - _current) - 12;
+            
+            if (contentSize > available || childrenSize > available - contentSize) {
+                _malformed = true;
+                return false;
+            }
+            
+            memcpy(chunk.id, _current, 4);
+            chunk.content = _current + 12;
+            chunk.contentSize = contentSize;
+            chunk.children = chunk.content + contentSize;
+            chunk.childrenSize = childrenSize;
+            
+            _current = chunk.children + childrenSize;
+            return true;
+        }
+        
+        void setMalformed() {
+            _malformed = true;
+        }
+        
+        bool isMalformed() const {
+            return _malformed;
+        }
+        
+    private:
+        const std::uint8_t *_current;
+        const std::uint8_t *_end;
+        bool _malformed = false;
+    };
+    
+    // Sets bits of @hidden for cells which have all six neighbours filled. Cells outside the grid are empty.
+    // Returns number of hidden cells.
+    //
+    std::size_t findHiddenCells(const ArenaVector<std::uint8_t> &grid, int sizeX, int sizeY, int sizeZ, ArenaVector<std::uint64_t> &occupancy, ArenaVector<std::uint64_t> &hidden) {
+        std::size_t hiddenCount = 0;
+        
+        occupancy.resize((grid.size() + 63) / 64);
+        hidden.assign(occupancy.size(), 0);
+        voxel::getVoxelKernels().occupancy(grid.data(), grid.size(), occupancy.data());
+        
+        auto occupied = [&](int x, int y, int z) {
+            if (x < 0 || y < 0 || z < 0 || x >= sizeX || y >= sizeY || z >= sizeZ) {
+                return false;
+            }
+            std::size_t i = (std::size_t(z) * sizeY + y) * sizeX + x;
+            return (occupancy[i >> 6] >> (i & 63) & 1) != 0;
+        };
+        
+        for (int z = 0; z < sizeZ; z++) {
+            for (int y = 0; y < sizeY; y++) {
+                for (int x = 0; x < sizeX; x++) {
+                    if (occupied(x, y, z) && occupied(x - 1, y, z) && occupied(x + 1, y, z) && occupied(x, y - 1, z) && occupied(x, y + 1, z) && occupied(x, y, z - 1) && occupied(x, y, z + 1)) {
+                        std::size_t i = (std::size_t(z) * sizeY + y) * sizeX + x;
+                        hidden[i >> 6] |= std::uint64_t(1) << (i & 63);
+                        hiddenCount++;
+                    }
+                }
+            }
+        }
+        
+        return hiddenCount;
+    }
+    
+    // Greedy merging of same-colored cells into boxes. Cells are consumed (zeroed) as they are emitted.
+    // Box extent on every axis is limited by @maxExtent to fit Voxel's scale bytes.
+    // Cells with bits set in @hidden (optional) can't be seen, so boxes of any color may cover them, but they never start a box.
+    //
+    template<typename EMIT> void mergeVoxels(std::uint8_t *grid, int sizeX, int sizeY, int sizeZ, int maxExtent, const std::uint64_t *hidden, EMIT &&emit) {
+        auto index = [&](int x, int y, int z) {
+            return (std::size_t(z) * sizeY + y) * sizeX + x;
+        };
+        auto cell = [&](int x, int y, int z) -> std::uint8_t & {
+            return grid[index(x, y, z)];
+        };
+        auto isHidden = [&](int x, int y, int z) {
+            std::size_t i = index(x, y, z);
+            return hidden && (hidden[i >> 6] >> (i & 63) & 1) != 0;
+        };
+        
+        for (int z = 0; z < sizeZ; z++) {
+            for (int y = 0; y < sizeY; y++) {
+                for (int x = 0; x < sizeX; x++) {
+                    std::uint8_t color = cell(x, y, z);
                     
-                    for (std::int32_t i = 0; i < modelCount; i++) {
-                        if (memcmp(data, "SIZE", 4) == 0) {
-                            std::int16_t centeringZ = *(std::int8_t *)(data + 12) / 2;
-                            std::int16_t centeringX = *(std::int8_t *)(data + 16) / 2;
-                            
-                            data += 24;
-                         
-                            if (memcmp(data, "XYZI", 4) == 0) {
-                                std::int32_t voxelCount = *(std::int32_t *)(data + 12);
-                                
-                                data += 16;
-                                result[i].voxels.resize(voxelCount);
-                                
-                                for (std::int32_t c = 0; c < voxelCount; c++) {
-                                    result[i].voxels[c].positionZ = *(std::int8_t *)(data + c * 4 + 0) - centeringZ;
-                                    result[i].voxels[c].positionX = *(std::int8_t *)(data + c * 4 + 1) - centeringX;
-                                    result[i].voxels[c].positionY = *(std::int8_t *)(data + c * 4 + 2);
-                                    result[i].voxels[c].colorIndex = *(std::uint8_t *)(data + c * 4 + 3) - 1;
-                                    
-                                    // TODO: voxel mesh optimization
-                                    result[i].voxels[c].scaleX = 1;
-                                    result[i].voxels[c].scaleY = 1;
-                                    result[i].voxels[c].scaleZ = 1;
+                    if (color && isHidden(x, y, z) == false) {
+                        int w = 1, h = 1, d = 1;
+                        
+                        auto matches = [&](int cx, int cy, int cz) {
+                            std::uint8_t c = cell(cx, cy, cz);
+                            return c == color || (c && isHidden(cx, cy, cz));
+                        };
+                        
+                        while (x + w < sizeX && w < maxExtent && matches(x + w, y, z)) {
+                            w++;
+                        }
+                        
+                        auto rowFilled = [&](int ry, int rz) {
+                            for (int i = 0; i < w; i++) {
+                                if (matches(x + i, ry, rz) == false) {
+                                    return false;
                                 }
-                                
-                                data += voxelCount * 4;
                             }
-                            else {
-                                platform->logError("[voxel::loadModel] XYZI[%d] chunk is not found in '%s'", i, fullPath);
-                                break;
+                            return true;
+                        };
+                        
+                        while (y + h < sizeY && h < maxExtent && rowFilled(y + h, z)) {
+                            h++;
+                        }
+                        
+                        auto layerFilled = [&](int rz) {
+                            for (int i = 0; i < h; i++) {
+                                if (rowFilled(y + i, rz) == false) {
+                                    return false;
+                                }
+                            }
+                            return true;
+                        };
+                        
+                        while (z + d < sizeZ && d < maxExtent && layerFilled(z + d)) {
+                            d++;
+                        }
+                        
+                        for (int k = 0; k < d; k++) {
+                            for (int j = 0; j < h; j++) {
+                                std::memset(&cell(x, y + j, z + k), 0, w);
                             }
                         }
-                        else {
-                            platform->logError("[voxel::loadModel] SIZE[%d] chunk is not found in '%s'", i, fullPath);
+                        
+                        emit(x, y, z, w, h, d, color);
+                    }
+                }
+            }
+        }
+    }
+    
+    // Visible cells of a model packed as x | y << 8 | z << 16 | color << 24
+    //
+    struct ModelCells {
+        std::int32_t sizeX, sizeY, sizeZ;
+        std::int32_t sourceCount;
+        std::int16_t offset[3]; // added to voxel positions, see modelOffset
+        ArenaVector<std::uint32_t> cells;
+    };
+    
+    // Centering of model plus ModelOptions::offset rounded to whole voxels. Vox axes x, y, z become Z, X, Y
+    //
+    void modelOffset(std::int32_t sizeX, std::int32_t sizeY, const voxel::ModelOptions &options, std::int16_t (&offset)[3]) {
+        offset[0] = std::int16_t(std::lround(options.offset.x) - sizeY / 2);
+        offset[1] = std::int16_t(std::lround(options.offset.y));
+        offset[2] = std::int16_t(std::lround(options.offset.z) - sizeX / 2);
+    }
+    
+    void gridDimensions(const ModelCells &m, int factor, int &gridX, int &gridY, int &gridZ) {
+        // coordinates are bytes, so grid never exceeds 256 on any axis
+        gridX = (std::min(m.sizeX, 256) + factor - 1) / factor;
+        gridY = (std::min(m.sizeY, 256) + factor - 1) / factor;
+        gridZ = (std::min(m.sizeZ, 256) + factor - 1) / factor;
+    }
+    
+    // Every grid cell covers factor^3 model cells and gets the most frequent color among them.
+    // Cell is filled if any of its model cells is filled, so thin parts and hollow shells survive downsampling.
+    //
+    void fillGrid(ArenaVector<std::uint8_t> &grid, const ModelCells &m, int factor, ArenaVector<std::uint32_t> &scratch) {
+        int gridX, gridY, gridZ;
+        gridDimensions(m, factor, gridX, gridY, gridZ);
+        grid.assign(std::size_t(gridX) * gridY * gridZ, 0);
+        
+        auto gridIndex = [&](std::uint32_t cell) {
+            return (std::uint32_t(cell >> 16 & 0xff) / factor * gridY + (cell >> 8 & 0xff) / factor) * gridX + (cell & 0xff) / factor;
+        };
+        
+        if (factor == 1) {
+            for (std::uint32_t cell : m.cells) {
+                grid[gridIndex(cell)] = std::uint8_t(cell >> 24);
+            }
+            
+            return;
+        }
+        
+        // grid index (at most 2^24) and color sorted together, so equal colors of a cell are adjacent
+        scratch.clear();
+        scratch.reserve(m.cells.size());
+        
+        for (std::uint32_t cell : m.cells) {
+            scratch.emplace_back(gridIndex(cell) << 8 | cell >> 24);
+        }
+        
+        std::sort(scratch.begin(), scratch.end());
+        
+        for (std::size_t i = 0, bestCount = 0; i < scratch.size(); ) {
+            std::size_t next = i + 1;
+            
+            while (next < scratch.size() && scratch[next] == scratch[i]) {
+                next++;
+            }
+            if (i == 0 || scratch[i] >> 8 != scratch[i - 1] >> 8) {
+                bestCount = 0;
+            }
+            if (next - i > bestCount) {
+                bestCount = next - i;
+                grid[scratch[i] >> 8] = std::uint8_t(scratch[i]);
+            }
+            
+            i = next;
+        }
+    }
+    
+    // Boxes are collected in arena @merged first, so every frame gets one allocation of exact size.
+    // Hidden cells (see mergeVoxels) which are not covered by boxes are dropped.
+    //
+    void mergeGrid(ArenaVector<std::uint8_t> &grid, const ModelCells &m, int factor, const std::uint64_t *hidden, ArenaVector<voxel::Voxel> &merged, voxel::Frame &frame) {
+        int gridX, gridY, gridZ;
+        gridDimensions(m, factor, gridX, gridY, gridZ);
+        // there are no more boxes than filled cells
+        merged.clear();
+        merged.reserve(m.cells.size());
+        
+        // merging is done in vox space: x -> Z, y -> X, z -> Y
+        mergeVoxels(grid.data(), gridX, gridY, gridZ, 255 / factor, hidden, [&](int x, int y, int z, int w, int h, int d, std::uint8_t color) {
+            voxel::Voxel voxel;
+            voxel.positionZ = std::int16_t(x * factor + m.offset[2]);
+            voxel.positionX = std::int16_t(y * factor + m.offset[0]);
+            voxel.positionY = std::int16_t(z * factor + m.offset[1]);
+            voxel.reserved = 0;
+            voxel.scaleZ = std::uint8_t(w * factor);
+            voxel.scaleX = std::uint8_t(h * factor);
+            voxel.scaleY = std::uint8_t(d * factor);
+            voxel.colorIndex = color - 1;
+            merged.emplace_back(voxel);
+        });
+        
+        frame.voxels.assign(merged.begin(), merged.end());
+    }
+    
+    // Builds frames of one detail level. With @deltaFrames base is intersection of all frames
+    // and every frame keeps only cells which are not in base.
+    // With @cullHidden cells enclosed within the merged grid are left to merging (see mergeVoxels), their count
+    // in every frame grid is written to @hiddenCounts if it's given.
+    //
+    void buildLevel(const ArenaVector<ModelCells> &models, int factor, bool deltaFrames, bool cullHidden, voxel::Frame &base, std::vector<voxel::Frame> &frames, Arena &arena, std::size_t *hiddenCounts = nullptr) {
+        ArenaVector<std::uint8_t> grid (arena), baseGrid (arena);
+        ArenaVector<std::uint32_t> scratch (arena);
+        ArenaVector<voxel::Voxel> merged (arena);
+        ArenaVector<std::uint64_t> occupancy (arena), hidden (arena);
+        
+        auto merge = [&](ArenaVector<std::uint8_t> &g, const ModelCells &m, voxel::Frame &frame) {
+            std::size_t hiddenCount = 0;
+            
+            if (cullHidden) {
+                int gridX, gridY, gridZ;
+                gridDimensions(m, factor, gridX, gridY, gridZ);
+                hiddenCount = findHiddenCells(g, gridX, gridY, gridZ, occupancy, hidden);
+            }
+            
+            mergeGrid(g, m, factor, cullHidden ? hidden.data() : nullptr, merged, frame);
+            return hiddenCount;
+        };
+        
+        if (deltaFrames) {
+            fillGrid(baseGrid, models[0], factor, scratch);
+            
+            for (std::size_t i = 1; i < models.size(); i++) {
+                fillGrid(grid, models[i], factor, scratch);
+                
+                for (std::size_t c = 0; c < grid.size(); c++) {
+                    baseGrid[c] = baseGrid[c] == grid[c] ? baseGrid[c] : 0;
+                }
+            }
+        }
+        
+        frames.resize(models.size());
+        
+        for (std::size_t i = 0; i < models.size(); i++) {
+            fillGrid(grid, models[i], factor, scratch);
+            
+            if (deltaFrames) {
+                for (std::size_t c = 0; c < grid.size(); c++) {
+                    grid[c] = grid[c] == baseGrid[c] ? 0 : grid[c];
+                }
+            }
+            
+            std::size_t hiddenCount = merge(grid, models[i], frames[i]);
+            
+            if (hiddenCounts) {
+                hiddenCounts[i] = hiddenCount;
+            }
+        }
+        
+        if (deltaFrames) {
+            merge(baseGrid, models[0], base);
+        }
+    }
+    
+    // Reads file into arena when it's reachable by the file system, otherwise platform reads it into @loaded.
+    // Returns nullptr if file is absent.
+    //
+    const std::uint8_t *readFile(const std::shared_ptr<platform::Platform> &platform, const char *fullPath, Arena *arena, std::unique_ptr<std::uint8_t []> &loaded, std::size_t &size) {
+        if (arena) {
+            int file = ::open(fullPath, O_RDONLY);
+            
+            if (file >= 0) {
+                struct stat info;
+                std::uint8_t *data = nullptr;
+                std::size_t offset = 0;
+                
+                if (fstat(file, &info) == 0) {
+                    size = std::size_t(info.st_size);
+                    data = static_cast<std::uint8_t *>(arena->allocate(size));
+                    
+                    while (offset < size) {
+                        ssize_t count = ::read(file, data + offset, size - offset);
+                        
+                        if (count <= 0) {
                             break;
                         }
+                        
+                        offset += std::size_t(count);
+                    }
+                }
+                
+                close(file);
+                
+                if (data && offset == size) {
+                    return data;
+                }
+            }
+        }
+        
+        return platform->loadFile(fullPath, loaded, size) ? loaded.get() : nullptr;
+    }
+    
+    // Lets model.info be parsed with stream operators without copying it
+    //
+    struct MemoryStreamBuffer : public std::streambuf {
+        MemoryStreamBuffer(const std::uint8_t *data, std::size_t size) {
+            char *begin = const_cast<char *>(reinterpret_cast<const char *>(data));
+            setg(begin, begin, begin + size);
+        }
+    };
+}
+
+namespace {
+    // model.cooked layout: header, frame table, animation table, animation names, palette (optional), voxels (4-byte aligned).
+    // Frame table has (1 + frameCount) entries for every level of detail: base voxels of delta frames, then frames.
+    //
+    struct CookedFrame {
+        std::uint32_t firstVoxel;
+        std::uint32_t voxelCount;
+    };
+    
+    struct CookedHeader {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t frameCount;
+        std::uint32_t animationCount;
+        std::uint32_t framesOffset;
+        std::uint32_t animationsOffset;
+        std::uint32_t voxelsOffset;
+        std::uint32_t voxelCount;
+        std::uint32_t levelCount;
+        std::uint32_t paletteOffset; // zero if model has no palette
+    };
+    
+    struct CookedAnimation {
+        std::uint32_t nameOffset;
+        std::uint32_t nameLength;
+        std::uint32_t firstFrame;
+        std::uint32_t lastFrame;
+        float frameRate;
+    };
+    
+    const char COOKED_MAGIC[4] = {'V', 'X', 'C', 'K'};
+    
+    // Every table must fit into file, so counts can't overflow index arithmetic of CookedModel.
+    // Sizes are computed in 64 bits: frameCount of 0xffffffff must not wrap (frameCount + 1) to zero.
+    //
+    bool validateCooked(const std::uint8_t *data, std::size_t size) {
+        const CookedHeader *header = reinterpret_cast<const CookedHeader *>(data);
+        
+        if (size < sizeof(CookedHeader) || memcmp(header->magic, COOKED_MAGIC, 4) != 0 || header->version != voxel::CookedModel::VERSION) {
+            return false;
+        }
+        
+        std::uint64_t frameEntries = std::uint64_t(header->levelCount) * (std::uint64_t(header->frameCount) + 1);
+        
+        if (header->framesOffset % 4 != 0 || header->animationsOffset % 4 != 0) {
+            return false;
+        }
+        if (header->levelCount == 0 || header->frameCount > size || header->levelCount > size || header->framesOffset + frameEntries * sizeof(CookedFrame) > size) {
+            return false;
+        }
+        if (header->animationsOffset + std::uint64_t(header->animationCount) * sizeof(CookedAnimation) > size) {
+            return false;
+        }
+        if (header->voxelsOffset % 4 != 0 || header->voxelsOffset + std::uint64_t(header->voxelCount) * sizeof(voxel::Voxel) > size) {
+            return false;
+        }
+        if (header->paletteOffset && header->paletteOffset + std::uint64_t(1024) > size) {
+            return false;
+        }
+        
+        const CookedFrame *frames = reinterpret_cast<const CookedFrame *>(data + header->framesOffset);
+        const CookedAnimation *animations = reinterpret_cast<const CookedAnimation *>(data + header->animationsOffset);
+        
+        for (std::uint64_t i = 0; i < frameEntries; i++) {
+            if (std::uint64_t(frames[i].firstVoxel) + frames[i].voxelCount > header->voxelCount) {
+                return false;
+            }
+        }
+        for (std::uint32_t i = 0; i < header->animationCount; i++) {
+            if (std::uint64_t(animations[i].nameOffset) + animations[i].nameLength > size) {
+                return false;
+            }
+            if (animations[i].firstFrame > animations[i].lastFrame || animations[i].lastFrame >= header->frameCount) {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+}
+
+namespace voxel {
+    CookedModel::~CookedModel() {
+        if (_mappedSize) {
+            munmap(const_cast<std::uint8_t *>(_data), _mappedSize);
+        }
+    }
+    
+    std::shared_ptr<CookedModel> CookedModel::open(const std::shared_ptr<platform::Platform> &platform, const char *fullPath) {
+        std::shared_ptr<CookedModel> result (new CookedModel ());
+        int file = ::open(fullPath, O_RDONLY);
+        
+        if (file >= 0) {
+            struct stat info;
+            
+            if (fstat(file, &info) == 0 && info.st_size > 0) {
+                void *mapped = mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+                
+                if (mapped != MAP_FAILED) {
+                    result->_data = static_cast<const std::uint8_t *>(mapped);
+                    result->_size = result->_mappedSize = std::size_t(info.st_size);
+                }
+            }
+            
+            close(file);
+        }
+        if (result->_data == nullptr) {
+            if (platform->loadFile(fullPath, result->_loadedData, result->_size) == false) {
+                return nullptr;
+            }
+            
+            result->_data = result->_loadedData.get();
+        }
+        if (validateCooked(result->_data, result->_size) == false) {
+            platform->logError("[voxel::CookedModel] '%s' is corrupted or has another version", fullPath);
+            return nullptr;
+        }
+        
+        return result;
+    }
+    
+    std::uint32_t CookedModel::getLevelCount() const {
+        return reinterpret_cast<const CookedHeader *>(_data)->levelCount;
+    }
+    
+    std::uint32_t CookedModel::getFrameCount() const {
+        return reinterpret_cast<const CookedHeader *>(_data)->frameCount;
+    }
+    
+    const Voxel *CookedModel::getFrameVoxels(std::uint32_t level, std::uint32_t index, std::uint32_t &voxelCount) const {
+        const CookedHeader *header = reinterpret_cast<const CookedHeader *>(_data);
+        const CookedFrame &frame = reinterpret_cast<const CookedFrame *>(_data + header->framesOffset)[level * (std::size_t(header->frameCount) + 1) + index + 1];
+        voxelCount = frame.voxelCount;
+        return reinterpret_cast<const Voxel *>(_data + header->voxelsOffset) + frame.firstVoxel;
+    }
+    
+    const Voxel *CookedModel::getBaseVoxels(std::uint32_t level, std::uint32_t &voxelCount) const {
+        const CookedHeader *header = reinterpret_cast<const CookedHeader *>(_data);
+        const CookedFrame &base = reinterpret_cast<const CookedFrame *>(_data + header->framesOffset)[level * (std::size_t(header->frameCount) + 1)];
+        voxelCount = base.voxelCount;
+        return reinterpret_cast<const Voxel *>(_data + header->voxelsOffset) + base.firstVoxel;
+    }
+    
+    std::uint32_t CookedModel::getAnimationCount() const {
+        return reinterpret_cast<const CookedHeader *>(_data)->animationCount;
+    }
+
+    const std::uint8_t *CookedModel::getPalette() const {
+        const CookedHeader *header = reinterpret_cast<const CookedHeader *>(_data);
+        return header->paletteOffset ? _data + header->paletteOffset : nullptr;
+    }
+    
+    AnimationInfo CookedModel::getAnimation(std::uint32_t index) const {
+        const CookedHeader *header = reinterpret_cast<const CookedHeader *>(_data);
+        const CookedAnimation &animation = reinterpret_cast<const CookedAnimation *>(_data + header->animationsOffset)[index];
+        return AnimationInfo {
+            std::string(reinterpret_cast<const char *>(_data + animation.nameOffset), animation.nameLength),
+            animation.firstFrame,
+            animation.lastFrame,
+            animation.frameRate
+        };
+    }
+    
+    ModelOptions makeModelOptions(const ModelInfo &info) {
+        ModelOptions result;
+        result.cullHidden = info.cullHidden;
+        result.deltaFrames = info.deltaFrames;
+        result.lodLevels = info.lodLevels;
+        return result;
+    }
+    
+    bool loadModelInfo(const std::shared_ptr<platform::Platform> &platform, const char *fullPath, ModelInfo &info, Arena *arena) {
+        std::unique_ptr<uint8_t []> infoData;
+        std::size_t infoSize = 0;
+        
+        if (const std::uint8_t *data = readFile(platform, fullPath, arena, infoData, infoSize)) {
+            MemoryStreamBuffer buffer (data, infoSize);
+            std::istream stream (&buffer);
+            std::string keyword;
+            
+            while (stream >> keyword) {
+                if (keyword == "animation") {
+                    AnimationInfo animation;
+                    
+                    if (stream >> utility::expect<'='> >> utility::quoted(animation.name) >> animation.firstFrame >> animation.lastFrame >> animation.frameRate) {
+                        info.animations.emplace_back(std::move(animation));
+                    }
+                    else {
+                        platform->logError("[voxel::loadModelInfo] Invalid animation '%s' arguments in '%s'", animation.name.data(), fullPath);
+                        return false;
+                    }
+                }
+                else if (keyword == "cull_hidden") {
+                    if (!(stream >> utility::expect<'='> >> std::boolalpha >> info.cullHidden)) {
+                        platform->logError("[voxel::loadModelInfo] Invalid cull_hidden argument in '%s'", fullPath);
+                        return false;
+                    }
+                }
+                else if (keyword == "delta_frames") {
+                    if (!(stream >> utility::expect<'='> >> std::boolalpha >> info.deltaFrames)) {
+                        platform->logError("[voxel::loadModelInfo] Invalid delta_frames argument in '%s'", fullPath);
+                        return false;
+                    }
+                }
+                else if (keyword == "lod_levels") {
+                    if (!(stream >> utility::expect<'='> >> info.lodLevels) || info.lodLevels > MAX_LOD_LEVELS) {
+                        platform->logError("[voxel::loadModelInfo] Invalid lod_levels argument in '%s', at most %d levels are supported", fullPath, int(MAX_LOD_LEVELS));
+                        return false;
                     }
                 }
                 else {
-                    platform->logError("[voxel::loadModel] PACK chunk is not found in '%s'", fullPath);
+                    platform->logError("[voxel::loadModelInfo] Unreconized keyword '%s' in '%s'", keyword.data(), fullPath);
+                    return false;
                 }
             }
+        }
+        
+        return true;
+    }
+    
+    bool parseModel(const std::shared_ptr<platform::Platform> &platform, const std::uint8_t *data, std::size_t size, const char *name, const ModelOptions &options, Model &model, Arena *arena) {
+        std::unique_ptr<Arena> temporaryArena (arena ? nullptr : new Arena ());
+        Arena &scratchArena = arena ? *arena : *temporaryArena;
+        VoxChunk main;
+        
+        model.base.voxels.clear();
+        model.frames.clear();
+        model.lods.clear();
+        model.palette.clear();
+        
+        if (size < 8 || memcmp(data, "VOX ", 4) != 0 || (readInt32(data + 4) != 150 && readInt32(data + 4) != 200)) {
+            platform->logError("[voxel::loadModel] Incorrect vox-header in '%s'", name);
+            return false;
+        }
+        if (VoxChunkIterator(data + 8, data + size).next(main) == false || memcmp(main.id, "MAIN", 4) != 0) {
+            platform->logError("[voxel::loadModel] MAIN chunk is not found in '%s'", name);
+            return false;
+        }
+        
+        VoxChunkIterator iterator (main.children, main.children + main.childrenSize);
+        VoxChunk chunk;
+        
+        // dense color grid (colorIndex + 1, zero is empty) and its occupancy bits reused by every frame
+        const VoxelKernels &kernels = getVoxelKernels();
+        ArenaVector<std::uint8_t> grid (scratchArena);
+        ArenaVector<std::uint64_t> occupancy (scratchArena);
+        ArenaVector<ModelCells> models (scratchArena);
+        std::int32_t sizeX = 0, sizeY = 0, sizeZ = 0;
+        bool hasSize = false;
+        
+        while (iterator.next(chunk)) {
+            if (memcmp(chunk.id, "SIZE", 4) == 0) {
+                if (chunk.contentSize < 12) {
+                    iterator.setMalformed();
+                    break;
+                }
+                
+                sizeX = readInt32(chunk.content + 0);
+                sizeY = readInt32(chunk.content + 4);
+                sizeZ = readInt32(chunk.content + 8);
+                
+                if (sizeX <= 0 || sizeY <= 0 || sizeZ <= 0) {
+                    iterator.setMalformed();
+                    break;
+                }
+                
+                hasSize = true;
+            }
+            else if (memcmp(chunk.id, "XYZI", 4) == 0) {
+                if (hasSize == false) {
+                    platform->logError("[voxel::loadModel] SIZE[%d] chunk is not found in '%s'", int(models.size()), name);
+                    iterator.setMalformed();
+                    break;
+                }
+                if (chunk.contentSize < 4 || std::uint32_t(readInt32(chunk.content)) > (chunk.contentSize - 4) / 4) {
+                    iterator.setMalformed();
+                    break;
+                }
+                
+                std::int32_t voxelCount = readInt32(chunk.content);
+                const std::uint8_t *xyzi = chunk.content + 4;
+                int gridX, gridY, gridZ;
+                
+                models.emplace_back(ModelCells {sizeX, sizeY, sizeZ, voxelCount, {}, ArenaVector<std::uint32_t>(scratchArena)});
+                modelOffset(sizeX, sizeY, options, models.back().offset);
+                gridDimensions(models.back(), 1, gridX, gridY, gridZ);
+                grid.assign(std::size_t(gridX) * gridY * gridZ, 0);
+                
+                std::uint8_t min[3] = {0, 0, 0}, max[3] = {0, 0, 0};
+                
+                if (voxelCount) {
+                    kernels.boundsXYZI(xyzi, voxelCount, min, max);
+                }
+                
+                // records of well-formed files are inside SIZE, so per-record checks are needed only if bounds say otherwise
+                if (max[0] < gridX && max[1] < gridY && max[2] < gridZ) {
+                    for (std::int32_t c = 0; c < voxelCount; c++) {
+                        grid[(std::size_t(xyzi[c * 4 + 2]) * gridY + xyzi[c * 4 + 1]) * gridX + xyzi[c * 4 + 0]] = xyzi[c * 4 + 3];
+                    }
+                }
+                else {
+                    for (std::int32_t c = 0; c < voxelCount; c++) {
+                        std::uint8_t x = xyzi[c * 4 + 0], y = xyzi[c * 4 + 1], z = xyzi[c * 4 + 2];
+                        
+                        if (x < gridX && y < gridY && z < gridZ) {
+                            grid[(std::size_t(z) * gridY + y) * gridX + x] = xyzi[c * 4 + 3];
+                        }
+                    }
+                }
+                
+                ArenaVector<std::uint32_t> &cells = models.back().cells;
+                cells.reserve(voxelCount);
+                occupancy.resize((grid.size() + 63) / 64);
+                kernels.occupancy(grid.data(), grid.size(), occupancy.data());
+                
+                // filled cells are taken from occupancy bits, so empty space costs a word test per 64 cells
+                for (std::size_t w = 0; w < occupancy.size(); w++) {
+                    for (std::uint64_t word = occupancy[w]; word; word &= word - 1) {
+                        std::uint32_t index = std::uint32_t(w * 64 + __builtin_ctzll(word));
+                        std::uint32_t x = index % gridX, y = index / gridX % gridY, z = index / gridX / gridY;
+                        cells.emplace_back(x | y << 8 | z << 16 | std::uint32_t(grid[index]) << 24);
+                    }
+                }
+                
+                hasSize = false;
+            }
+            else if (memcmp(chunk.id, "RGBA", 4) == 0) {
+                if (chunk.contentSize < 1024) {
+                    iterator.setMalformed();
+                    break;
+                }
+                
+                model.palette.assign(chunk.content, chunk.content + 1024);
+            }
+            
+            // PACK, scene graph (nTRN, nGRP, nSHP), LAYR, MATL, rOBJ, rCAM, NOTE, IMAP and unknown chunks are skipped
+        }
+        
+        if (iterator.isMalformed()) {
+            platform->logError("[voxel::loadModel] Malformed chunk in '%s'", name);
+            model.palette.clear();
+            return false;
+        }
+        
+        bool deltaFrames = options.deltaFrames && models.size() > 1;
+        
+        for (auto &m : models) {
+            if (m.sizeX != models[0].sizeX || m.sizeY != models[0].sizeY || m.sizeZ != models[0].sizeZ) {
+                if (deltaFrames) {
+                    platform->logError("[voxel::loadModel] Models of '%s' have different sizes, delta frames are disabled", name);
+                }
+                
+                deltaFrames = false;
+            }
+        }
+        
+        ArenaVector<std::size_t> hiddenCounts (models.size(), 0, scratchArena);
+        buildLevel(models, 1, deltaFrames, options.cullHidden, model.base, model.frames, scratchArena, hiddenCounts.data());
+        
+        for (std::size_t i = 0; i < models.size(); i++) {
+            platform->logMsg("[voxel::loadModel] Frame %d of '%s': %d voxels merged to %d", int(i), name, models[i].sourceCount, int(model.frames[i].voxels.size()));
+            
+            if (options.cullHidden) {
+                platform->logMsg("[voxel::loadModel] Frame %d of '%s': %d hidden voxels are not drawn on their own", int(i), name, int(hiddenCounts[i]));
+            }
+        }
+        if (deltaFrames) {
+            platform->logMsg("[voxel::loadModel] Base of '%s': %d voxels shared by %d frames", name, int(model.base.voxels.size()), int(models.size()));
+        }
+        
+        model.lods.resize(std::min(options.lodLevels, MAX_LOD_LEVELS));
+        
+        for (std::size_t i = 0; i < model.lods.size(); i++) {
+            LodLevel &lod = model.lods[i];
+            lod.factor = 2u << i;
+            buildLevel(models, int(lod.factor), deltaFrames, options.cullHidden, lod.base, lod.frames, scratchArena);
+            
+            std::size_t voxelCount = lod.base.voxels.size();
+            
+            for (auto &frame : lod.frames) {
+                voxelCount += frame.voxels.size();
+            }
+            
+            platform->logMsg("[voxel::loadModel] LOD x%d of '%s': %d voxels in %d frames", int(lod.factor), name, int(voxelCount), int(lod.frames.size()));
+        }
+        
+        return true;
+    }
+    
+    bool parseModelVoxels(const std::shared_ptr<platform::Platform> &platform, const std::uint8_t *data, std::size_t size, const char *name, const ModelOptions &options, std::vector<Frame> &frames) {
+        VoxChunk main;
+        frames.clear();
+        
+        if (size < 8 || memcmp(data, "VOX ", 4) != 0 || (readInt32(data + 4) != 150 && readInt32(data + 4) != 200)) {
+            platform->logError("[voxel::parseModelVoxels] Incorrect vox-header in '%s'", name);
+            return false;
+        }
+        if (VoxChunkIterator(data + 8, data + size).next(main) == false || memcmp(main.id, "MAIN", 4) != 0) {
+            platform->logError("[voxel::parseModelVoxels] MAIN chunk is not found in '%s'", name);
+            return false;
+        }
+        
+        VoxChunkIterator iterator (main.children, main.children + main.childrenSize);
+        VoxChunk chunk;
+        std::int16_t offset[3];
+        bool hasSize = false;
+        
+        while (iterator.next(chunk)) {
+            if (memcmp(chunk.id, "SIZE", 4) == 0) {
+                if (chunk.contentSize < 12) {
+                    iterator.setMalformed();
+                    break;
+                }
+                
+                modelOffset(readInt32(chunk.content + 0), readInt32(chunk.content + 4), options, offset);
+                hasSize = true;
+            }
+            else if (memcmp(chunk.id, "XYZI", 4) == 0) {
+                if (hasSize == false || chunk.contentSize < 4 || std::uint32_t(readInt32(chunk.content)) > (chunk.contentSize - 4) / 4) {
+                    iterator.setMalformed();
+                    break;
+                }
+                
+                std::size_t voxelCount = std::uint32_t(readInt32(chunk.content));
+                frames.emplace_back();
+                frames.back().voxels.resize(voxelCount);
+                getVoxelKernels().decodeXYZI(chunk.content + 4, voxelCount, offset, frames.back().voxels.data());
+                hasSize = false;
+            }
+        }
+        
+        if (iterator.isMalformed()) {
+            platform->logError("[voxel::parseModelVoxels] Malformed chunk in '%s'", name);
+            frames.clear();
+            return false;
+        }
+        
+        return true;
+    }
+    
+    bool loadModel(const std::shared_ptr<platform::Platform> &platform, const char *fullPath, const ModelOptions &options, Model &model, Arena *arena) {
+        std::unique_ptr<std::uint8_t []> voxData;
+        std::size_t voxSize = 0;
+        
+        if (const std::uint8_t *data = readFile(platform, fullPath, arena, voxData, voxSize)) {
+            return parseModel(platform, data, voxSize, fullPath, options, model, arena);
+        }
+        
+        platform->logError("[voxel::loadModel] Unable to find file '%s'", fullPath);
+        return false;
+    }
+    
+    void buildFaces(const Voxel *voxels, std::size_t voxelCount, std::vector<Face> &faces) {
+        if (voxelCount == 0) {
+            return;
+        }
+        
+        int lo[3] = {INT32_MAX, INT32_MAX, INT32_MAX};
+        int hi[3] = {INT32_MIN, INT32_MIN, INT32_MIN};
+        
+        for (std::size_t i = 0; i < voxelCount; i++) {
+            const Voxel &v = voxels[i];
+            int position[3] = {v.positionX, v.positionY, v.positionZ};
+            int scale[3] = {v.scaleX, v.scaleY, v.scaleZ};
+            
+            for (int a = 0; a < 3; a++) {
+                lo[a] = std::min(lo[a], position[a]);
+                hi[a] = std::max(hi[a], position[a] + scale[a]);
+            }
+        }
+        
+        // cells keep colorIndex + 1, zero is empty
+        int size[3] = {hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]};
+        std::vector<std::uint16_t> grid (std::size_t(size[0]) * size[1] * size[2], 0);
+        
+        auto cellIndex = [&](const int (&cell)[3]) {
+            return (std::size_t(cell[2]) * size[1] + cell[1]) * size[0] + cell[0];
+        };
+        
+        for (std::size_t i = 0; i < voxelCount; i++) {
+            const Voxel &v = voxels[i];
+            int cell[3];
+            
+            for (cell[2] = v.positionZ - lo[2]; cell[2] < v.positionZ - lo[2] + v.scaleZ; cell[2]++) {
+                for (cell[1] = v.positionY - lo[1]; cell[1] < v.positionY - lo[1] + v.scaleY; cell[1]++) {
+                    for (cell[0] = v.positionX - lo[0]; cell[0] < v.positionX - lo[0] + v.scaleX; cell[0]++) {
+                        grid[cellIndex(cell)] = std::uint16_t(v.colorIndex + 1);
+                    }
+                }
+            }
+        }
+        
+        std::vector<std::uint16_t> mask;
+        
+        for (int direction = 0; direction < 6; direction++) {
+            int a = direction / 2, u = (a + 1) % 3, v = (a + 2) % 3;
+            int step = direction % 2 ? -1 : 1;
+            
+            mask.assign(std::size_t(size[u]) * size[v], 0);
+            
+            for (int slice = 0; slice < size[a]; slice++) {
+                int cell[3], neighbour[3];
+                cell[a] = slice;
+                
+                for (cell[v] = 0; cell[v] < size[v]; cell[v]++) {
+                    for (cell[u] = 0; cell[u] < size[u]; cell[u]++) {
+                        std::uint16_t color = grid[cellIndex(cell)];
+                        
+                        neighbour[a] = slice + step;
+                        neighbour[u] = cell[u];
+                        neighbour[v] = cell[v];
+                        
+                        if (color && neighbour[a] >= 0 && neighbour[a] < size[a] && grid[cellIndex(neighbour)]) {
+                            color = 0;
+                        }
+                        
+                        mask[std::size_t(cell[v]) * size[u] + cell[u]] = color;
+                    }
+                }
+                
+                // rectangles grow along u, then along v while whole rows match; extents fit Face's size bytes
+                for (int j = 0; j < size[v]; j++) {
+                    for (int i = 0; i < size[u]; i++) {
+                        std::uint16_t color = mask[std::size_t(j) * size[u] + i];
+                        
+                        if (color == 0) {
+                            continue;
+                        }
+                        
+                        int w = 1, h = 1;
+                        
+                        while (i + w < size[u] && w < 255 && mask[std::size_t(j) * size[u] + i + w] == color) {
+                            w++;
+                        }
+                        
+                        auto rowFilled = [&](int row) {
+                            for (int k = 0; k < w; k++) {
+                                if (mask[std::size_t(row) * size[u] + i + k] != color) {
+                                    return false;
+                                }
+                            }
+                            return true;
+                        };
+                        
+                        while (j + h < size[v] && h < 255 && rowFilled(j + h)) {
+                            h++;
+                        }
+                        
+                        for (int k = 0; k < h; k++) {
+                            std::fill_n(&mask[std::size_t(j + k) * size[u] + i], w, 0);
+                        }
+                        
+                        int position[3];
+                        position[a] = slice + lo[a];
+                        position[u] = i + lo[u];
+                        position[v] = j + lo[v];
+                        
+                        Face face;
+                        face.positionX = std::int16_t(position[0]);
+                        face.positionY = std::int16_t(position[1]);
+                        face.positionZ = std::int16_t(position[2]);
+                        face.direction = std::int16_t(direction);
+                        face.sizeU = std::uint8_t(w);
+                        face.sizeV = std::uint8_t(h);
+                        face.reserved = 0;
+                        face.colorIndex = std::uint8_t(color - 1);
+                        faces.emplace_back(face);
+                    }
+                }
+            }
+        }
+    }
+    
+    void mergeCells(std::uint8_t *grid, int sizeX, int sizeY, int sizeZ, std::vector<Voxel> &voxels) {
+        mergeVoxels(grid, sizeX, sizeY, sizeZ, 255, nullptr, [&](int x, int y, int z, int w, int h, int d, std::uint8_t color) {
+            Voxel voxel;
+            voxel.positionX = std::int16_t(x);
+            voxel.positionY = std::int16_t(y);
+            voxel.positionZ = std::int16_t(z);
+            voxel.reserved = 0;
+            voxel.scaleX = std::uint8_t(w);
+            voxel.scaleY = std::uint8_t(h);
+            voxel.scaleZ = std::uint8_t(d);
+            voxel.colorIndex = color - 1;
+            voxels.emplace_back(voxel);
+        });
+    }
+    
+    bool cookModel(const std::shared_ptr<platform::Platform> &platform, const char *fullPath, const Model &model, const ModelInfo &info) {
+        const std::vector<Frame> &frames = model.frames;
+        CookedHeader header;
+        std::vector<CookedFrame> cookedFrames;
+        std::vector<CookedAnimation> cookedAnimations;
+        std::string names;
+        
+        // level 0 is full model
+        std::vector<std::pair<const Frame *, const std::vector<Frame> *>> levels = {{&model.base, &frames}};
+        
+        for (auto &lod : model.lods) {
+            levels.emplace_back(&lod.base, &lod.frames);
+        }
+        
+        // animations out of frame range would make the whole file rejected by CookedModel::open
+        std::vector<const AnimationInfo *> animations;
+        
+        for (auto &animation : info.animations) {
+            if (animation.firstFrame <= animation.lastFrame && animation.lastFrame < frames.size()) {
+                animations.emplace_back(&animation);
+            }
             else {
-                platform->logError("[voxel::loadModel] Incorrect vox-header in '%s'", fullPath);
+                platform->logError("[voxel::cookModel] Animation '%s' of '%s' is out of %d frames and is skipped", animation.name.data(), fullPath, int(frames.size()));
             }
         }
-        else {
-            platform->logError("[voxel::loadModel] Unable to find file '%s'", fullPath);
+        
+        memcpy(header.magic, COOKED_MAGIC, 4);
+        header.version = CookedModel::VERSION;
+        header.frameCount = std::uint32_t(frames.size());
+        header.animationCount = std::uint32_t(animations.size());
+        header.levelCount = std::uint32_t(levels.size());
+        header.framesOffset = sizeof(CookedHeader);
+        header.animationsOffset = header.framesOffset + header.levelCount * (header.frameCount + 1) * sizeof(CookedFrame);
+        header.voxelCount = 0;
+        
+        for (auto &level : levels) {
+            cookedFrames.emplace_back(CookedFrame {header.voxelCount, std::uint32_t(level.first->voxels.size())});
+            header.voxelCount += std::uint32_t(level.first->voxels.size());
+            
+            for (auto &frame : *level.second) {
+                cookedFrames.emplace_back(CookedFrame {header.voxelCount, std::uint32_t(frame.voxels.size())});
+                header.voxelCount += std::uint32_t(frame.voxels.size());
+            }
+        }
+        
+        std::uint32_t namesOffset = header.animationsOffset + header.animationCount * sizeof(CookedAnimation);
+        
+        for (const AnimationInfo *animation : animations) {
+            cookedAnimations.emplace_back(CookedAnimation {
+                namesOffset + std::uint32_t(names.size()),
+                std::uint32_t(animation->name.size()),
+                std::uint32_t(animation->firstFrame),
+                std::uint32_t(animation->lastFrame),
+                animation->frameRate
+            });
+            names += animation->name;
+        }
+        
+        names.resize((namesOffset + names.size() + 3) / 4 * 4 - namesOffset, '\0');
+        header.paletteOffset = model.palette.size() ? namesOffset + std::uint32_t(names.size()) : 0;
+        header.voxelsOffset = namesOffset + std::uint32_t(names.size() + model.palette.size());
+        
+        // Written next to target and renamed over it, so memory mappings of the old file (CookedModel) keep its inode
+        std::string tmpPath = std::string(fullPath) + ".tmp";
+        bool result = false;
+        
+        if (std::FILE *file = std::fopen(tmpPath.data(), "wb")) {
+            result = std::fwrite(&header, sizeof(CookedHeader), 1, file) == 1;
+            result = result && (cookedFrames.empty() || std::fwrite(&cookedFrames[0], sizeof(CookedFrame), cookedFrames.size(), file) == cookedFrames.size());
+            result = result && (cookedAnimations.empty() || std::fwrite(&cookedAnimations[0], sizeof(CookedAnimation), cookedAnimations.size(), file) == cookedAnimations.size());
+            result = result && std::fwrite(names.data(), 1, names.size(), file) == names.size();
+            result = result && (model.palette.empty() || std::fwrite(model.palette.data(), 1, model.palette.size(), file) == model.palette.size());
+            
+            auto writeVoxels = [&](const Frame &frame) {
+                result = result && (frame.voxels.empty() || std::fwrite(&frame.voxels[0], sizeof(Voxel), frame.voxels.size(), file) == frame.voxels.size());
+            };
+            
+            for (auto &level : levels) {
+                writeVoxels(*level.first);
+                
+                for (auto &frame : *level.second) {
+                    writeVoxels(frame);
+                }
+            }
+            
+            result = std::fflush(file) == 0 && result;
+            result = std::fclose(file) == 0 && result;
+            result = result && std::rename(tmpPath.data(), fullPath) == 0;
+            
+            if (result == false) {
+                std::remove(tmpPath.data());
+            }
+        }
+        if (result == false) {
+            platform->logError("[voxel::cookModel] Unable to write '%s'", fullPath);
         }
         
         return result;
     }
     
-    std::shared_ptr<platform::Texture2D> loadPalette(
-        const std::shared_ptr<platform::Platform> &platform,
-        const std::shared_ptr<platform::RenderingDevice> &renderingDevice,
-        const char *fullPath
-    ) {
-        std::shared_ptr<platform::Texture2D> result;
+    bool cookMesh(const std::shared_ptr<platform::Platform> &platform, const char *fullFolderPath) {
+        std::string infoPath = std::string(fullFolderPath) + "/model.info";
+        std::string modelPath = std::string(fullFolderPath) + "/model.vox";
+        std::string cookedPath = std::string(fullFolderPath) + "/model.cooked";
+        ModelInfo info;
+        
+        Model model;
+        
+        if (loadModelInfo(platform, infoPath.data(), info)) {
+            if (loadModel(platform, modelPath.data(), makeModelOptions(info), model) && model.frames.size()) {
+                return cookModel(platform, cookedPath.data(), model, info);
+            }
+        }
+        
+        return false;
+    }
+    
+    std::uint64_t hashContent(const std::uint8_t *data, std::size_t size) {
+        std::uint64_t result = 14695981039346656037ull;
+        
+        for (std::size_t i = 0; i < size; i++) {
+            result = (result ^ data[i]) * 1099511628211ull;
+        }
+        
+        return result;
+    }
+
+    bool PaletteCache::find(std::uint64_t fileHash, std::vector<std::uint8_t> &rgba) const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        auto index = _palettes.find(fileHash);
+        
+        if (index != _palettes.end()) {
+            rgba = index->second;
+            return true;
+        }
+        
+        return false;
+    }
+
+    void PaletteCache::add(std::uint64_t fileHash, const std::vector<std::uint8_t> &rgba) {
+        std::lock_guard<std::mutex> guard (_mutex);
+        _palettes[fileHash] = rgba;
+    }
+
+    bool decodePalette(const std::shared_ptr<platform::Platform> &platform, const char *fullPath, std::vector<std::uint8_t> &rgba, PaletteCache *cache) {
         std::unique_ptr<std::uint8_t []> paletteData;
         std::size_t paletteSize;
+        bool result = false;
         
         if (platform->loadFile(fullPath, paletteData, paletteSize)) {
-            lib::upng_t* upng = lib::upng_new_from_bytes(paletteData.get(), paletteSize);
+            std::uint64_t fileHash = cache ? hashContent(paletteData.get(), paletteSize) : 0;
+            lib::upng_t* upng = nullptr;
             
-            if (upng != nullptr) {
+            if (cache && cache->find(fileHash, rgba)) {
+                result = true;
+            }
+            else if ((upng = lib::upng_new_from_bytes(paletteData.get(), paletteSize)) != nullptr) {
                 if (*reinterpret_cast<const unsigned *>(paletteData.get()) == 0x474E5089 && lib::upng_decode(upng) == lib::UPNG_EOK) {
                     if (lib::upng_get_format(upng) == lib::UPNG_RGBA8 && lib::upng_get_width(upng) == 256 && lib::upng_get_height(upng) == 1) {
-                        result = renderingDevice->createTexture(platform::Texture2D::Format::RGBA8UN, 256, 1, {lib::upng_get_buffer(upng)});
+                        rgba.assign(lib::upng_get_buffer(upng), lib::upng_get_buffer(upng) + 256 * 4);
+                        result = true;
                         
-                        if (result == nullptr) {
-                            platform->logError("[voxel::loadTexture] Unable to create platform::Texture2D for '%s'", fullPath);
+                        if (cache) {
+                            cache->add(fileHash, rgba);
                         }
                     }
                     else {
@@ -120,4 +1167,23 @@ namespace voxel {
 
         return result;
     }
+    
+    std::shared_ptr<platform::Texture2D> loadPalette(
+        const std::shared_ptr<platform::Platform> &platform,
+        const std::shared_ptr<platform::RenderingDevice> &renderingDevice,
+        const char *fullPath
+    ) {
+        std::shared_ptr<platform::Texture2D> result;
+        std::vector<std::uint8_t> rgba;
+        
+        if (decodePalette(platform, fullPath, rgba)) {
+            result = renderingDevice->createTexture(platform::Texture2D::Format::RGBA8UN, 256, 1, {&rgba[0]});
+            
+            if (result == nullptr) {
+                platform->logError("[voxel::loadTexture] Unable to create platform::Texture2D for '%s'", fullPath);
+            }
+        }
+
+        return result;
+    }
 }
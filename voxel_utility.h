@@ -1,9 +1,15 @@
 
 #pragma once
 
+#include <mutex>
+#include <unordered_map>
+
 #include "utility/math.h"
+#include "utility/common.h"
 #include "platform/interfaces.h"
 
+class Arena;
+
 namespace voxel {
     struct Voxel {
         std::int16_t positionX, positionY, positionZ, reserved;
@@ -13,11 +19,188 @@ namespace voxel {
         std::vector<Voxel> voxels;
     };
     
-    // Load *.vox at fullPath.
+    static_assert(sizeof(Voxel) == 12, "Voxel is uploaded to GPU as is");
+    
+    // Visible rectangle of frame surface made of cell faces of one color, see buildFaces
+    //
+    struct Face {
+        std::int16_t positionX, positionY, positionZ; // min corner cell
+        std::int16_t direction; // outward normal: 0 +X, 1 -X, 2 +Y, 3 -Y, 4 +Z, 5 -Z
+        std::uint8_t sizeU, sizeV; // in cells along axes (direction / 2 + 1) % 3 and (direction / 2 + 2) % 3
+        std::uint8_t reserved, colorIndex;
+    };
+    
+    static_assert(sizeof(Face) == 12, "Face is uploaded to GPU as is");
+    
+    struct AnimationInfo {
+        std::string name;
+        std::size_t firstFrame;
+        std::size_t lastFrame;
+        float frameRate;
+    };
+    
+    // Content of model.info
+    //
+    struct ModelInfo {
+        std::vector<AnimationInfo> animations;
+        bool cullHidden = false;
+        bool deltaFrames = false;
+        std::size_t lodLevels = 2;
+    };
+    
+    // Coarse levels of detail are built in addition to full model
+    //
+    constexpr std::size_t MAX_LOD_LEVELS = 3;
+    
+    struct ModelOptions {
+        // Added to voxel's positions, rounded to whole voxels
+        math::vector3f offset = {0, 0, 0};
+        
+        // Voxels covered from all six sides are not drawn on their own: merged boxes may extend over them, but never start there
+        bool cullHidden = false;
+        
+        // Move voxels which are the same in all frames to Model::base, frames keep only the rest
+        bool deltaFrames = false;
+        
+        // Count of coarse levels of detail. Level N has cells of (2 << N) voxels on every axis
+        std::size_t lodLevels = 0;
+    };
+    
+    struct LodLevel {
+        std::uint32_t factor; // cell size in model voxels
+        Frame base;
+        std::vector<Frame> frames;
+    };
+    
+    // Every frame is drawn as base voxels plus its own voxels. Base is empty unless delta frames are requested.
+    //
+    struct Model {
+        Frame base;
+        std::vector<Frame> frames;
+        std::vector<LodLevel> lods;
+        std::vector<std::uint8_t> palette; // embedded RGBA chunk (1024 bytes, layout of loadPalette), empty if absent
+    };
+    
+    // Cooked model: frames in upload layout and animation table, see cookModel.
+    // File is memory-mapped when fullPath is reachable by the file system, otherwise it's read by platform.
+    //
+    class CookedModel {
+    public:
+        static constexpr std::uint32_t VERSION = 4;
+        
+        ~CookedModel();
+        
+        // Returns nullptr if file is absent or has other version.
+        //
+        static std::shared_ptr<CookedModel> open(const std::shared_ptr<platform::Platform> &platform, const char *fullPath);
+        
+        // Level 0 is full model, next levels are Model::lods
+        //
+        std::uint32_t getLevelCount() const;
+        std::uint32_t getFrameCount() const;
+        const Voxel *getFrameVoxels(std::uint32_t level, std::uint32_t index, std::uint32_t &voxelCount) const;
+        const Voxel *getBaseVoxels(std::uint32_t level, std::uint32_t &voxelCount) const;
+        
+        std::uint32_t getAnimationCount() const;
+        AnimationInfo getAnimation(std::uint32_t index) const;
+        
+        // Embedded RGBA palette of source model (1024 bytes), nullptr if absent
+        //
+        const std::uint8_t *getPalette() const;
+        
+    private:
+        CookedModel() = default;
+        
+        const std::uint8_t *_data = nullptr;
+        std::size_t _size = 0;
+        std::size_t _mappedSize = 0;
+        std::unique_ptr<std::uint8_t []> _loadedData;
+    };
+    
+    // Load model.info at fullPath. Absent file is not an error and gives default info.
+    // File is read into @arena when it's given (see loadModel).
+    //
+    bool loadModelInfo(const std::shared_ptr<platform::Platform> &platform, const char *fullPath, ModelInfo &info, Arena *arena = nullptr);
+    ModelOptions makeModelOptions(const ModelInfo &info);
+    
+    // Parse *.vox content (versions 150 and 200). Every model of the file becomes a frame in file order.
     // Center of model is at {sizeX / 2, 0, sizeZ / 2}.
-    // @offset is added to voxel's positions
+    // Voxels of the same color are merged into boxes: position is the min corner voxel, scale is box size in voxels.
+    // Levels of detail downsample every frame, cell takes the most frequent color of voxels it covers.
+    // Chunks other than SIZE, XYZI and RGBA (PACK, scene graph, materials, layers...) are skipped.
+    // Malformed content gives false, no reads are made outside of [data, data + size).
+    // Intermediate grids and cell lists are taken from @arena (or from temporary one), every frame of @model is one exact allocation.
+    // @name is used for logging
+    //
+    bool parseModel(
+        const std::shared_ptr<platform::Platform> &platform,
+        const std::uint8_t *data,
+        std::size_t size,
+        const char *name,
+        const ModelOptions &options,
+        Model &model,
+        Arena *arena = nullptr
+    );
+    
+    // Load *.vox at fullPath, see parseModel.
+    // With @arena file is read into it when fullPath is reachable by the file system. Nothing in @model points to arena,
+    // so caller may reset arena right after the call.
+    //
+    bool loadModel(const std::shared_ptr<platform::Platform> &platform, const char *fullPath, const ModelOptions &options, Model &model, Arena *arena = nullptr);
+    
+    // Unit voxels of every model of *.vox content in file order, without merging. Meant for bulk import of large scans
+    // and generated models into editable storage (see BrickVolume::fromVoxels). Positions are placed like parseModel ones,
+    // other options are ignored. Records are not checked against SIZE, repeated cells are kept.
+    //
+    bool parseModelVoxels(
+        const std::shared_ptr<platform::Platform> &platform,
+        const std::uint8_t *data,
+        std::size_t size,
+        const char *name,
+        const ModelOptions &options,
+        std::vector<Frame> &frames
+    );
+    
+    // Greedy meshing of voxels surface: cell faces without filled neighbour are merged into rectangles per color and direction.
+    // Faces are appended ordered by direction. Voxels must not overlap.
+    //
+    void buildFaces(const Voxel *voxels, std::size_t voxelCount, std::vector<Face> &faces);
+    
+    // Greedy merging of same-colored cells of dense grid (x is the fastest axis, cell is colorIndex + 1, zero is empty) into boxes.
+    // Grid is consumed. Boxes are appended to @voxels with positions relative to grid origin.
+    //
+    void mergeCells(std::uint8_t *grid, int sizeX, int sizeY, int sizeZ, std::vector<Voxel> &voxels);
+
+    // Write frames and animations to cooked model file at fullPath (plain file system path).
+    // File is written as fullPath + ".tmp" and renamed over the previous one, so its memory mappings stay valid.
+    //
+    bool cookModel(const std::shared_ptr<platform::Platform> &platform, const char *fullPath, const Model &model, const ModelInfo &info);
+    
+    // Offline step: load model.info and model.vox from folder and write model.cooked next to them.
+    // VoxelMeshes prefers model.cooked when it exists.
+    //
+    bool cookMesh(const std::shared_ptr<platform::Platform> &platform, const char *fullFolderPath);
+
+    // FNV-1a hash of content
+    //
+    std::uint64_t hashContent(const std::uint8_t *data, std::size_t size);
+
+    // Decoded palettes by hash of their png file content. Thread-safe.
+    //
+    class PaletteCache : public utility::NonCopyable, public utility::NonMovable {
+    public:
+        bool find(std::uint64_t fileHash, std::vector<std::uint8_t> &rgba) const;
+        void add(std::uint64_t fileHash, const std::vector<std::uint8_t> &rgba);
+
+    private:
+        mutable std::mutex _mutex;
+        std::unordered_map<std::uint64_t, std::vector<std::uint8_t>> _palettes;
+    };
+
+    // Decode 256x1 RGBA *.png at fullPath into @rgba (1024 bytes). Doesn't touch rendering device, may be called from any thread.
+    // With @cache png is decoded only if no file of the same content is decoded before.
     //
-    std::vector<Frame> loadModel(const std::shared_ptr<platform::Platform> &platform, const char *fullPath, const math::vector3f &offset);
+    bool decodePalette(const std::shared_ptr<platform::Platform> &platform, const char *fullPath, std::vector<std::uint8_t> &rgba, PaletteCache *cache = nullptr);
 
     // Load 256x1 RGBA *.png at fullPath (1024 bytes data).
     //
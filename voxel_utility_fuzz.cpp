@@ -0,0 +1,310 @@
+// Fuzz harness of voxel file parsers: every input goes to parseModel (default and all options), parseModelVoxels,
+// loadModelInfo and CookedModel::open with all of its getters. Malformed input must be rejected without reads
+// outside of it, so build with address and undefined behaviour sanitizers. Input is served by platform for a path
+// which is absent on disk, so cooked model is read into exact heap allocation instead of being memory-mapped.
+//
+// libFuzzer build, seed corpus is data/knight/model.vox plus model.cooked made by cookMesh:
+//   clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -DVOXEL_LIBFUZZER -I<include path> voxel_utility_fuzz.cpp voxel_utility.cpp voxel_kernels.cpp -lpthread
+// Standalone build mutates the same seeds by itself, exit code is not zero if any seed is rejected:
+//   g++ -std=c++17 -g -O1 -fsanitize=address,undefined -I<include path> voxel_utility_fuzz.cpp voxel_utility.cpp voxel_kernels.cpp -lpthread
+//
+// Usage: voxel_utility_fuzz [iterations] [more seed files...], run from repository root (data/knight is cooked in a copy)
+//
+#include "voxel_utility.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const char *const INPUT_PATH = "/nonexistent/voxel_utility_fuzz/input";
+
+    // Serves current input for INPUT_PATH and reads other files from working directory. Malformed inputs are expected,
+    // so nothing is logged.
+    //
+    class FuzzPlatform : public platform::Platform {
+    public:
+        void setInput(const std::uint8_t *data, std::size_t size) {
+            _input = data;
+            _inputSize = size;
+        }
+
+        float getNativeScreenWidth() const override {
+            return 0.0f;
+        }
+
+        float getNativeScreenHeight() const override {
+            return 0.0f;
+        }
+
+        bool loadFile(const char *path, std::unique_ptr<std::uint8_t[]> &data, std::size_t &size) override {
+            bool result = false;
+
+            if (std::strcmp(path, INPUT_PATH) == 0) {
+                size = _inputSize;
+                data = std::make_unique<std::uint8_t[]>(size);
+
+                if (size) {
+                    std::memcpy(data.get(), _input, size);
+                }
+
+                result = true;
+            }
+            else if (FILE *file = fopen(path, "rb")) {
+                if (fseek(file, 0, SEEK_END) == 0) {
+                    long length = ftell(file);
+
+                    if (length >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+                        size = std::size_t(length);
+                        data = std::make_unique<std::uint8_t[]>(size);
+                        result = fread(data.get(), 1, size, file) == size;
+                    }
+                }
+
+                fclose(file);
+            }
+
+            return result;
+        }
+
+        platform::EventHandlersToken addTouchEventHandlers(
+            std::function<void(const platform::TouchEventArgs &)> &&,
+            std::function<void(const platform::TouchEventArgs &)> &&,
+            std::function<void(const platform::TouchEventArgs &)> &&
+        ) override {
+            return nullptr;
+        }
+
+        void removeEventHandlers(platform::EventHandlersToken) override {}
+        void run(std::function<void(float)> &&) override {}
+        void logMsg(const char *, ...) override {}
+        void logError(const char *, ...) override {}
+
+    private:
+        const std::uint8_t *_input = nullptr;
+        std::size_t _inputSize = 0;
+    };
+
+    const std::shared_ptr<FuzzPlatform> &getPlatform() {
+        static std::shared_ptr<FuzzPlatform> platform = std::make_shared<FuzzPlatform>();
+        return platform;
+    }
+
+    // Sum of everything returned, so every voxel and name byte is actually read
+    //
+    std::uint64_t touch(const voxel::Voxel *voxels, std::size_t count) {
+        std::uint64_t result = 0;
+
+        for (std::size_t i = 0; i < count; i++) {
+            result += std::uint64_t(std::uint16_t(voxels[i].positionX)) + voxels[i].scaleX + voxels[i].colorIndex;
+        }
+
+        return result;
+    }
+
+    std::uint64_t touch(const voxel::Model &model) {
+        std::uint64_t result = touch(model.base.voxels.data(), model.base.voxels.size()) + model.palette.size();
+
+        for (const voxel::Frame &frame : model.frames) {
+            result += touch(frame.voxels.data(), frame.voxels.size());
+        }
+        for (const voxel::LodLevel &lod : model.lods) {
+            result += touch(lod.base.voxels.data(), lod.base.voxels.size());
+
+            for (const voxel::Frame &frame : lod.frames) {
+                result += touch(frame.voxels.data(), frame.voxels.size());
+            }
+        }
+
+        return result;
+    }
+
+    std::uint64_t touch(const voxel::CookedModel &cooked) {
+        std::uint64_t result = 0;
+        std::uint32_t voxelCount = 0;
+
+        for (std::uint32_t level = 0; level < cooked.getLevelCount(); level++) {
+            const voxel::Voxel *voxels = cooked.getBaseVoxels(level, voxelCount);
+            result += touch(voxels, voxelCount);
+
+            for (std::uint32_t i = 0; i < cooked.getFrameCount(); i++) {
+                voxels = cooked.getFrameVoxels(level, i, voxelCount);
+                result += touch(voxels, voxelCount);
+            }
+        }
+        for (std::uint32_t i = 0; i < cooked.getAnimationCount(); i++) {
+            voxel::AnimationInfo animation = cooked.getAnimation(i);
+
+            for (char c : animation.name) {
+                result += std::uint8_t(c);
+            }
+        }
+        if (const std::uint8_t *palette = cooked.getPalette()) {
+            for (std::size_t i = 0; i < 1024; i++) {
+                result += palette[i];
+            }
+        }
+
+        return result;
+    }
+
+    // Returns true if any parser accepts input
+    //
+    bool parse(const std::uint8_t *data, std::size_t size) {
+        const std::shared_ptr<FuzzPlatform> &platform = getPlatform();
+        volatile std::uint64_t sink = 0;
+        bool result = false;
+
+        voxel::ModelOptions fullOptions;
+        fullOptions.cullHidden = true;
+        fullOptions.deltaFrames = true;
+        fullOptions.lodLevels = voxel::MAX_LOD_LEVELS;
+
+        for (const voxel::ModelOptions &options : {voxel::ModelOptions {}, fullOptions}) {
+            voxel::Model model;
+
+            if (voxel::parseModel(platform, data, size, "fuzz", options, model)) {
+                sink = sink + touch(model);
+                result = true;
+            }
+        }
+
+        std::vector<voxel::Frame> frames;
+
+        if (voxel::parseModelVoxels(platform, data, size, "fuzz", {}, frames)) {
+            for (const voxel::Frame &frame : frames) {
+                sink = sink + touch(frame.voxels.data(), frame.voxels.size());
+            }
+
+            result = true;
+        }
+
+        platform->setInput(data, size);
+
+        if (std::shared_ptr<voxel::CookedModel> cooked = voxel::CookedModel::open(platform, INPUT_PATH)) {
+            sink = sink + touch(*cooked);
+            result = true;
+        }
+
+        voxel::ModelInfo info;
+        voxel::loadModelInfo(platform, INPUT_PATH, info);
+        platform->setInput(nullptr, 0);
+        return result;
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size) {
+    parse(data, size);
+    return 0;
+}
+
+#ifndef VOXEL_LIBFUZZER
+
+namespace {
+    const std::size_t DEFAULT_ITERATIONS = 20000;
+    const std::size_t MAX_MUTATIONS = 8;
+    const std::uint32_t INTERESTING_VALUES[] = {0, 1, 0x7f, 0x80, 0xff, 0x100, 0xffff, 0x7fffffff, 0x80000000, 0xffffffff};
+
+    bool readSeed(const std::string &path, std::vector<std::vector<std::uint8_t>> &seeds) {
+        std::unique_ptr<std::uint8_t[]> data;
+        std::size_t size = 0;
+
+        if (getPlatform()->loadFile(path.data(), data, size)) {
+            seeds.emplace_back(data.get(), data.get() + size);
+            return true;
+        }
+
+        printf("Unable to read seed '%s'\n", path.data());
+        return false;
+    }
+
+    // Mutations which hit chunk sizes, counts and offsets of both formats: bit flips, interesting bytes and
+    // 32-bit values at aligned offsets, truncation, and a copy of one range over another
+    //
+    void mutate(std::vector<std::uint8_t> &input, std::mt19937 &random) {
+        std::size_t count = 1 + random() % MAX_MUTATIONS;
+
+        for (std::size_t k = 0; k < count && input.size(); k++) {
+            std::size_t offset = random() % input.size();
+            std::uint32_t value = INTERESTING_VALUES[random() % std::size(INTERESTING_VALUES)];
+
+            switch (random() % 5) {
+                case 0:
+                    input[offset] ^= std::uint8_t(1u << (random() % 8));
+                    break;
+                case 1:
+                    input[offset] = std::uint8_t(value);
+                    break;
+                case 2:
+                    offset &= ~std::size_t(3);
+
+                    if (offset + 4 <= input.size()) {
+                        std::memcpy(input.data() + offset, &value, 4);
+                    }
+                    break;
+                case 3:
+                    input.resize(offset);
+                    break;
+                default: {
+                    std::size_t from = random() % input.size();
+                    std::size_t length = std::min(random() % 64, std::min(input.size() - from, input.size() - offset));
+                    std::memmove(input.data() + offset, input.data() + from, length);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::size_t iterations = argc > 1 ? std::size_t(std::strtoull(argv[1], nullptr, 10)) : DEFAULT_ITERATIONS;
+    std::filesystem::path folder = std::filesystem::temp_directory_path() / "voxel_utility_fuzz";
+    std::vector<std::vector<std::uint8_t>> seeds;
+    int failures = 0;
+
+    std::filesystem::remove_all(folder);
+    std::filesystem::create_directories(folder);
+    std::filesystem::copy("data/knight", folder, std::filesystem::copy_options::recursive);
+
+    if (voxel::cookMesh(getPlatform(), folder.string().data()) == false) {
+        printf("Unable to cook '%s'\n", folder.string().data());
+        failures++;
+    }
+
+    failures += readSeed("data/knight/model.vox", seeds) == false;
+    failures += readSeed((folder / "model.cooked").string(), seeds) == false;
+
+    for (int i = 2; i < argc; i++) {
+        failures += readSeed(argv[i], seeds) == false;
+    }
+    for (const std::vector<std::uint8_t> &seed : seeds) {
+        if (parse(seed.data(), seed.size()) == false) {
+            printf("Seed of %d bytes is rejected\n", int(seed.size()));
+            failures++;
+        }
+    }
+
+    std::mt19937 random (1);
+    std::size_t accepted = 0;
+
+    for (std::size_t i = 0; i < iterations && seeds.size(); i++) {
+        std::vector<std::uint8_t> input = seeds[i % seeds.size()];
+        mutate(input, random);
+        accepted += parse(input.data(), input.size());
+    }
+
+    std::filesystem::remove_all(folder);
+    printf("%s: %d inputs, %d accepted, %d failures\n", argv[0], int(iterations), int(accepted), failures);
+    return failures;
+}
+
+#endif
@@ -0,0 +1,362 @@
+#include "voxel_world.h"
+#include "voxel_utility.h"
+#include "voxel_bricks.h"
+#include "voxel_kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    static constexpr std::int32_t CHUNK_SIZE = voxel::VoxelWorld::CHUNK_SIZE;
+    static constexpr std::int32_t CHUNK_SHIFT = 5;
+
+    static_assert(CHUNK_SIZE == 1 << CHUNK_SHIFT, "Cell coordinates are split into chunk and local ones by shift");
+    static_assert(CHUNK_SIZE <= 255, "Boxes of chunk must fit Voxel's scale bytes");
+    static_assert(voxel::VoxelWorld::WORLD_EXTENT >> CHUNK_SHIFT <= 1 << 20, "Chunk coordinates must fit 21 bits of chunk key");
+
+    static constexpr float DEFAULT_REBUILD_BUDGET_MS = 2.0f;
+
+    // Chunk coordinates are packed by 21 bits, so world spans 2^26 cells on every axis (see WORLD_EXTENT)
+    //
+    std::uint64_t chunkKey(std::int32_t x, std::int32_t y, std::int32_t z) {
+        return std::uint64_t(std::uint32_t(x) & 0x1fffff) | std::uint64_t(std::uint32_t(y) & 0x1fffff) << 21 | std::uint64_t(std::uint32_t(z) & 0x1fffff) << 42;
+    }
+
+    bool isInWorld(std::int32_t x, std::int32_t y, std::int32_t z) {
+        const std::int32_t extent = voxel::VoxelWorld::WORLD_EXTENT;
+        return x >= -extent && x < extent && y >= -extent && y < extent && z >= -extent && z < extent;
+    }
+}
+
+namespace voxel {
+    class VoxelWorldImp : public VoxelWorld {
+    public:
+        VoxelWorldImp(
+            const std::shared_ptr<platform::Platform> &platform,
+            const std::shared_ptr<platform::RenderingDevice> &renderingDevice,
+            const std::shared_ptr<Camera> &camera,
+            const std::shared_ptr<VoxelMeshes> &meshes
+        ) {
+            _platform = platform;
+            _renderingDevice = renderingDevice;
+            _camera = camera;
+            _meshes = meshes;
+        }
+        
+        bool setCell(std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t value) {
+            if (isInWorld(x, y, z) == false) {
+                _platform->logError("[VoxelWorld] Cell (%d, %d, %d) is out of world", int(x), int(y), int(z));
+                return false;
+            }
+            if (Chunk *chunk = _getChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, z >> CHUNK_SHIFT, value != 0)) {
+                if (_writeCell(*chunk, x & (CHUNK_SIZE - 1), y & (CHUNK_SIZE - 1), z & (CHUNK_SIZE - 1), value)) {
+                    _markDirty(*chunk);
+                }
+            }
+            
+            return true;
+        }
+        
+        bool getVoxel(std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t &colorIndex) const {
+            auto index = isInWorld(x, y, z) ? _chunks.find(chunkKey(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, z >> CHUNK_SHIFT)) : _chunks.end();
+            
+            if (index != _chunks.end()) {
+                return index->second->cells.get(x & (CHUNK_SIZE - 1), y & (CHUNK_SIZE - 1), z & (CHUNK_SIZE - 1), colorIndex);
+            }
+            
+            return false;
+        }
+        
+        // Goes through chunks overlapping the box, so large edits don't look up chunk for every cell
+        //
+        bool editBox(const std::int32_t (&min)[3], const std::int32_t (&max)[3], std::uint8_t value) {
+            std::int32_t chunkMin[3], chunkMax[3];
+            
+            if (isInWorld(min[0], min[1], min[2]) == false || isInWorld(max[0], max[1], max[2]) == false) {
+                _platform->logError("[VoxelWorld] Box (%d, %d, %d) - (%d, %d, %d) is out of world", int(min[0]), int(min[1]), int(min[2]), int(max[0]), int(max[1]), int(max[2]));
+                return false;
+            }
+            
+            for (int a = 0; a < 3; a++) {
+                if (min[a] > max[a]) {
+                    return true;
+                }
+                
+                chunkMin[a] = min[a] >> CHUNK_SHIFT;
+                chunkMax[a] = max[a] >> CHUNK_SHIFT;
+            }
+            
+            for (std::int32_t cz = chunkMin[2]; cz <= chunkMax[2]; cz++) {
+                for (std::int32_t cy = chunkMin[1]; cy <= chunkMax[1]; cy++) {
+                    for (std::int32_t cx = chunkMin[0]; cx <= chunkMax[0]; cx++) {
+                        Chunk *chunk = _getChunk(cx, cy, cz, value != 0);
+                        
+                        if (chunk == nullptr) {
+                            continue;
+                        }
+                        
+                        std::int32_t origin[3] = {cx * CHUNK_SIZE, cy * CHUNK_SIZE, cz * CHUNK_SIZE};
+                        std::int32_t lo[3], hi[3];
+                        bool changed = false;
+                        
+                        for (int a = 0; a < 3; a++) {
+                            lo[a] = std::max(min[a], origin[a]) - origin[a];
+                            hi[a] = std::min(max[a], origin[a] + CHUNK_SIZE - 1) - origin[a];
+                        }
+                        for (std::int32_t z = lo[2]; z <= hi[2]; z++) {
+                            for (std::int32_t y = lo[1]; y <= hi[1]; y++) {
+                                for (std::int32_t x = lo[0]; x <= hi[0]; x++) {
+                                    changed |= _writeCell(*chunk, x, y, z, value);
+                                }
+                            }
+                        }
+                        
+                        if (changed) {
+                            _markDirty(*chunk);
+                        }
+                    }
+                }
+            }
+            
+            return true;
+        }
+        
+        void updateAndDraw() {
+            _statistics = Statistics();
+            _rebuildDirtyChunks();
+            _frustum.set(_camera->getVPMatrix());
+            
+            for (auto &index : _chunks) {
+                const Chunk &chunk = *index.second;
+                
+                if (chunk.voxelCount == 0) {
+                    continue;
+                }
+                
+                math::transform3f transform = _getChunkTransform(chunk);
+                const float *m = transform.flat16;
+                math::vector3f localCenter = (chunk.boundsMin + chunk.boundsMax) * 0.5f;
+                math::vector3f localExtent = (chunk.boundsMax - chunk.boundsMin) * 0.5f;
+                math::vector3f center (
+                    localCenter.x * m[0] + localCenter.y * m[4] + localCenter.z * m[8] + m[12],
+                    localCenter.x * m[1] + localCenter.y * m[5] + localCenter.z * m[9] + m[13],
+                    localCenter.x * m[2] + localCenter.y * m[6] + localCenter.z * m[10] + m[14]
+                );
+                math::vector3f extent (
+                    localExtent.x * std::abs(m[0]) + localExtent.y * std::abs(m[4]) + localExtent.z * std::abs(m[8]),
+                    localExtent.x * std::abs(m[1]) + localExtent.y * std::abs(m[5]) + localExtent.z * std::abs(m[9]),
+                    localExtent.x * std::abs(m[2]) + localExtent.y * std::abs(m[6]) + localExtent.z * std::abs(m[10])
+                );
+                
+                if ((center - _camera->getPosition()).length() - extent.length() > _drawDistance || _frustum.isBoxVisible(center, extent) == false) {
+                    _statistics.chunksCulled++;
+                    continue;
+                }
+                
+                _meshes->drawVoxels(chunk.data, chunk.voxelCount, transform, _paletteRow);
+                _statistics.chunksDrawn++;
+                _statistics.drawCalls++;
+                _statistics.instancesSubmitted += chunk.voxelCount;
+            }
+        }
+        
+        Statistics getStatistics() const {
+            Statistics result = _statistics;
+            result.chunks = std::uint32_t(_chunks.size());
+            result.dirtyChunks = std::uint32_t(_dirtyChunks.size());
+            
+            for (auto &index : _chunks) {
+                result.gpuBytes += index.second->voxelCount * sizeof(voxel::Voxel);
+                result.cellBytes += index.second->cells.getMemoryBytes();
+            }
+            
+            return result;
+        }
+        
+        std::shared_ptr<platform::Platform> _platform;
+        std::shared_ptr<platform::RenderingDevice> _renderingDevice;
+        std::shared_ptr<Camera> _camera;
+        std::shared_ptr<VoxelMeshes> _meshes;
+        
+        math::transform3f _transform = math::transform3f::identity();
+        std::uint32_t _paletteRow = std::numeric_limits<std::uint32_t>::max(); // default palette of meshes
+        float _drawDistance = std::numeric_limits<float>::max();
+        float _rebuildBudgetMs = DEFAULT_REBUILD_BUDGET_MS;
+        Frustum _frustum;
+        Statistics _statistics;
+
+    private:
+        struct Chunk {
+            std::int32_t x, y, z; // origin cell is (x, y, z) * CHUNK_SIZE
+            bool dirty = false;
+            
+            // result of the last rebuild
+            std::uint32_t voxelCount = 0;
+            std::shared_ptr<platform::StructuredData> data;
+            math::vector3f boundsMin = {0, 0, 0};
+            math::vector3f boundsMax = {0, 0, 0};
+            
+            voxel::BrickVolume cells = voxel::BrickVolume({0, 0, 0}, {CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE}); // chunk local cells
+        };
+        
+        std::unordered_map<std::uint64_t, std::unique_ptr<Chunk>> _chunks;
+        std::vector<Chunk *> _dirtyChunks;
+        
+        // rebuild scratch
+        std::vector<std::uint8_t> _grid;
+        std::vector<voxel::Voxel> _voxels;
+        
+        Chunk *_getChunk(std::int32_t x, std::int32_t y, std::int32_t z, bool create) {
+            std::uint64_t key = chunkKey(x, y, z);
+            auto index = _chunks.find(key);
+            
+            if (index != _chunks.end()) {
+                return index->second.get();
+            }
+            if (create == false) {
+                return nullptr;
+            }
+            
+            std::unique_ptr<Chunk> &chunk = _chunks[key];
+            chunk = std::make_unique<Chunk>();
+            chunk->x = x;
+            chunk->y = y;
+            chunk->z = z;
+            return chunk.get();
+        }
+        
+        // @value is colorIndex + 1, zero clears the cell. Returns true if cell is changed
+        //
+        static bool _writeCell(Chunk &chunk, std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t value) {
+            return value ? chunk.cells.set(x, y, z, std::uint8_t(value - 1)) : chunk.cells.clear(x, y, z);
+        }
+        
+        void _markDirty(Chunk &chunk) {
+            if (chunk.dirty == false) {
+                chunk.dirty = true;
+                _dirtyChunks.emplace_back(&chunk);
+            }
+        }
+        
+        // World transform moved to chunk origin
+        //
+        math::transform3f _getChunkTransform(const Chunk &chunk) const {
+            math::transform3f result = _transform;
+            float origin[3] = {float(chunk.x * CHUNK_SIZE), float(chunk.y * CHUNK_SIZE), float(chunk.z * CHUNK_SIZE)};
+            
+            for (int i = 0; i < 3; i++) {
+                result.flat16[12 + i] += origin[0] * _transform.flat16[i] + origin[1] * _transform.flat16[4 + i] + origin[2] * _transform.flat16[8 + i];
+            }
+            
+            return result;
+        }
+        
+        // Nearest dirty chunks are merged into boxes and uploaded first. Emptied chunks are removed.
+        //
+        void _rebuildDirtyChunks() {
+            if (_dirtyChunks.empty()) {
+                return;
+            }
+            
+            auto start = std::chrono::steady_clock::now();
+            auto distance = [this](const Chunk *chunk) {
+                float halfChunk = float(CHUNK_SIZE / 2);
+                math::vector3f center = math::vector3f(float(chunk->x * CHUNK_SIZE) + halfChunk, float(chunk->y * CHUNK_SIZE) + halfChunk, float(chunk->z * CHUNK_SIZE) + halfChunk);
+                const float *m = _transform.flat16;
+                math::vector3f world (
+                    center.x * m[0] + center.y * m[4] + center.z * m[8] + m[12],
+                    center.x * m[1] + center.y * m[5] + center.z * m[9] + m[13],
+                    center.x * m[2] + center.y * m[6] + center.z * m[10] + m[14]
+                );
+                return (world - _camera->getPosition()).length();
+            };
+            
+            // farthest first, chunks are taken from the back
+            std::sort(_dirtyChunks.begin(), _dirtyChunks.end(), [&distance](const Chunk *a, const Chunk *b) {
+                return distance(a) > distance(b);
+            });
+            
+            while (_dirtyChunks.size() && (_statistics.chunksRebuilt == 0 || std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() < _rebuildBudgetMs)) {
+                Chunk &chunk = *_dirtyChunks.back();
+                _dirtyChunks.pop_back();
+                _statistics.chunksRebuilt++;
+                
+                if (chunk.cells.getCellCount() == 0) {
+                    _chunks.erase(chunkKey(chunk.x, chunk.y, chunk.z));
+                    continue;
+                }
+                
+                _voxels.clear();
+                chunk.cells.toVoxels(_voxels, _grid);
+                
+                chunk.dirty = false;
+                chunk.voxelCount = std::uint32_t(_voxels.size());
+                chunk.data = _renderingDevice->createData(_voxels.data(), chunk.voxelCount, sizeof(voxel::Voxel));
+                
+                std::int32_t min[3], max[3];
+                voxel::getVoxelKernels().boundsVoxels(_voxels.data(), _voxels.size(), min, max);
+                chunk.boundsMin = math::vector3f(min[0] - 0.5f, min[1] - 0.5f, min[2] - 0.5f);
+                chunk.boundsMax = math::vector3f(max[0] - 0.5f, max[1] - 0.5f, max[2] - 0.5f);
+            }
+            
+            _statistics.rebuildTimeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    bool VoxelWorld::setVoxel(std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t colorIndex) {
+        return static_cast<VoxelWorldImp *>(this)->setCell(x, y, z, std::uint8_t(colorIndex + 1));
+    }
+
+    bool VoxelWorld::clearVoxel(std::int32_t x, std::int32_t y, std::int32_t z) {
+        return static_cast<VoxelWorldImp *>(this)->setCell(x, y, z, 0);
+    }
+
+    bool VoxelWorld::getVoxel(std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t &colorIndex) const {
+        return static_cast<const VoxelWorldImp *>(this)->getVoxel(x, y, z, colorIndex);
+    }
+
+    bool VoxelWorld::fillBox(const std::int32_t (&min)[3], const std::int32_t (&max)[3], std::uint8_t colorIndex) {
+        return static_cast<VoxelWorldImp *>(this)->editBox(min, max, std::uint8_t(colorIndex + 1));
+    }
+
+    bool VoxelWorld::clearBox(const std::int32_t (&min)[3], const std::int32_t (&max)[3]) {
+        return static_cast<VoxelWorldImp *>(this)->editBox(min, max, 0);
+    }
+
+    void VoxelWorld::setTransform(const math::transform3f &fullTransform) {
+        static_cast<VoxelWorldImp *>(this)->_transform = fullTransform;
+    }
+
+    void VoxelWorld::setPalette(std::uint32_t row) {
+        static_cast<VoxelWorldImp *>(this)->_paletteRow = row;
+    }
+
+    void VoxelWorld::setDrawDistance(float distance) {
+        static_cast<VoxelWorldImp *>(this)->_drawDistance = distance;
+    }
+
+    void VoxelWorld::setRebuildBudget(float milliseconds) {
+        static_cast<VoxelWorldImp *>(this)->_rebuildBudgetMs = milliseconds;
+    }
+
+    void VoxelWorld::updateAndDraw() {
+        static_cast<VoxelWorldImp *>(this)->updateAndDraw();
+    }
+
+    VoxelWorld::Statistics VoxelWorld::getStatistics() const {
+        return static_cast<const VoxelWorldImp *>(this)->getStatistics();
+    }
+
+    std::shared_ptr<VoxelWorld> makeVoxelWorld(
+        const std::shared_ptr<platform::Platform> &platform,
+        const std::shared_ptr<platform::RenderingDevice> &renderingDevice,
+        const std::shared_ptr<Camera> &camera,
+        const std::shared_ptr<VoxelMeshes> &meshes
+    ) {
+        return std::make_shared<VoxelWorldImp>(platform, renderingDevice, camera, meshes);
+    }
+}
@@ -0,0 +1,86 @@
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "utility/math.h"
+#include "utility/common.h"
+
+#include "platform/interfaces.h"
+#include "camera.h"
+#include "voxel_meshes.h"
+
+namespace voxel {
+    // Editable voxel volume of unbounded size split into chunks of CHUNK_SIZE^3 cells.
+    // Every chunk keeps its cells merged into boxes in own GPU buffer of voxel::Voxel layout (positions relative to the chunk).
+    // Edits only mark chunks dirty, updateAndDraw rebuilds them within a time budget, so edited chunks show previous content meanwhile.
+    // Cell (x, y, z) is unit box centered at (x, y, z) in world space before world transform.
+    // Chunks are drawn by VoxelMeshes::drawVoxels, so they share shader and palette atlas with meshes.
+    //
+    class VoxelWorld : public utility::NonCopyable, public utility::NonMovable {
+    public:
+        static constexpr std::int32_t CHUNK_SIZE = 32;
+        
+        // Cell coordinates are in [-WORLD_EXTENT, WORLD_EXTENT) on every axis
+        //
+        static constexpr std::int32_t WORLD_EXTENT = 1 << 25;
+        
+        // @colorIndex is in [0, 254] like voxels of .vox models.
+        // Edits of cells out of WORLD_EXTENT are logged as errors and return false.
+        //
+        bool setVoxel(std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t colorIndex);
+        bool clearVoxel(std::int32_t x, std::int32_t y, std::int32_t z);
+        bool getVoxel(std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t &colorIndex) const;
+        
+        // Cells in [min, max] inclusive on every axis
+        //
+        bool fillBox(const std::int32_t (&min)[3], const std::int32_t (&max)[3], std::uint8_t colorIndex);
+        bool clearBox(const std::int32_t (&min)[3], const std::int32_t (&max)[3]);
+        
+        void setTransform(const math::transform3f &fullTransform);
+        
+        // Row of VoxelMeshes palette atlas used for colors of all chunks. Default palette of meshes is used until it's set.
+        //
+        void setPalette(std::uint32_t row);
+        
+        // Chunks farther than @distance from camera are not drawn. Frustum culling is always on.
+        //
+        void setDrawDistance(float distance);
+        
+        // Time per updateAndDraw spent on rebuilding dirty chunks, nearest to camera first.
+        // At least one chunk is rebuilt per call regardless of the budget. Default is 2 ms.
+        //
+        void setRebuildBudget(float milliseconds);
+        
+        void updateAndDraw();
+        
+        struct Statistics {
+            // Last updateAndDraw
+            std::uint32_t chunksDrawn = 0;
+            std::uint32_t chunksCulled = 0;
+            std::uint32_t chunksRebuilt = 0;
+            std::uint32_t drawCalls = 0;
+            std::uint32_t instancesSubmitted = 0;
+            float rebuildTimeMs = 0.0f;
+            
+            // Current state
+            std::uint32_t chunks = 0;
+            std::uint32_t dirtyChunks = 0;
+            std::size_t gpuBytes = 0;
+            std::size_t cellBytes = 0; // CPU side brick storage of cells
+        };
+        
+        Statistics getStatistics() const;
+
+    protected:
+        VoxelWorld() = default;
+    };
+
+    std::shared_ptr<VoxelWorld> makeVoxelWorld(
+        const std::shared_ptr<platform::Platform> &platform,
+        const std::shared_ptr<platform::RenderingDevice> &renderingDevice,
+        const std::shared_ptr<Camera> &camera,
+        const std::shared_ptr<VoxelMeshes> &meshes
+    );
+}
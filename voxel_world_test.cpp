@@ -0,0 +1,309 @@
+// Headless tests of VoxelWorld, exit code is the count of failed checks:
+// - edits: setVoxel, clearVoxel, fillBox and clearBox across chunk borders and at negative coordinates, read back by getVoxel
+// - dirty marking: only chunks with changed cells are marked, emptied chunks are removed by their rebuild
+// - rebuild budget: zero budget rebuilds one chunk per updateAndDraw nearest to camera first, small budget is not overrun
+//   by more than one chunk
+// - world extent: edits out of WORLD_EXTENT are rejected and don't alias cells inside
+// - drawing: chunks are drawn with the shader and palette atlas of VoxelMeshes
+//
+// Usage: voxel_world_test, run from repository root
+// Build like voxel_benchmark.cpp:
+//   g++ -std=c++17 -O2 -I<include path> voxel_world_test.cpp voxel_world.cpp voxel_meshes.cpp voxel_utility.cpp voxel_kernels.cpp voxel_bricks.cpp voxel_palettes.cpp -lpthread
+//
+#include "headless_platform.h"
+#include "voxel_meshes.h"
+#include "voxel_utility.h"
+#include "voxel_world.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    const std::int32_t CHUNK_SIZE = voxel::VoxelWorld::CHUNK_SIZE;
+    const std::int32_t EXTENT = voxel::VoxelWorld::WORLD_EXTENT;
+
+    int failures = 0;
+
+    void check(bool condition, const char *description) {
+        if (condition == false) {
+            printf("FAILED: %s\n", description);
+            failures++;
+        }
+    }
+
+    struct Scene {
+        std::shared_ptr<HeadlessPlatform> platform = std::make_shared<HeadlessPlatform>();
+        std::shared_ptr<HeadlessRenderingDevice> renderingDevice = std::make_shared<HeadlessRenderingDevice>();
+        std::shared_ptr<Camera> camera = std::make_shared<Camera>(platform);
+        std::shared_ptr<voxel::VoxelMeshes> meshes;
+        std::shared_ptr<voxel::VoxelWorld> world;
+
+        // Camera at (0, 0, 200) looks at origin
+        //
+        Scene() {
+            camera->setPerspectiveProj(50.0f, 0.1f, 5000.0f);
+            camera->setLookAtByRight(math::vector3f(0, 0, 200), math::vector3f(0, 0, 0), math::vector3f(1, 0, 0));
+            meshes = voxel::makeVoxelMeshes(platform, renderingDevice, camera, {});
+            world = voxel::makeVoxelWorld(platform, renderingDevice, camera, meshes);
+        }
+
+        void drawFrame() {
+            renderingDevice->prepareFrame();
+            meshes->updateAndDraw(1.0f / 60.0f);
+            world->updateAndDraw();
+        }
+    };
+
+    bool hasVoxel(const voxel::VoxelWorld &world, std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t colorIndex) {
+        std::uint8_t result = 0;
+        return world.getVoxel(x, y, z, result) && result == colorIndex;
+    }
+
+    bool isEmpty(const voxel::VoxelWorld &world, std::int32_t x, std::int32_t y, std::int32_t z) {
+        std::uint8_t result = 0;
+        return world.getVoxel(x, y, z, result) == false;
+    }
+
+    void testEdits() {
+        Scene scene;
+        voxel::VoxelWorld &world = *scene.world;
+
+        check(world.setVoxel(0, 0, 0, 5), "setVoxel inside world succeeds");
+        check(world.setVoxel(-1, -1, -1, 254), "setVoxel at negative coordinates succeeds");
+        check(world.setVoxel(CHUNK_SIZE, 0, -CHUNK_SIZE - 1, 0), "setVoxel in other chunks succeeds");
+        check(hasVoxel(world, 0, 0, 0, 5), "cell keeps its color");
+        check(hasVoxel(world, -1, -1, -1, 254), "negative cell keeps its color");
+        check(hasVoxel(world, CHUNK_SIZE, 0, -CHUNK_SIZE - 1, 0), "color 0 is a filled cell");
+        check(isEmpty(world, 1, 0, 0) && isEmpty(world, -CHUNK_SIZE, 0, 0), "other cells are empty");
+        check(world.getStatistics().chunks == 3, "cells of three chunks make three chunks");
+
+        check(world.clearVoxel(0, 0, 0), "clearVoxel succeeds");
+        check(isEmpty(world, 0, 0, 0), "cleared cell is empty");
+        check(world.clearVoxel(100, 100, 100), "clearVoxel of empty cell succeeds");
+        check(world.getStatistics().chunks == 3, "clearing empty chunk doesn't create it");
+
+        // box across eight chunks around origin
+        const std::int32_t min[3] = {-5, -6, -7};
+        const std::int32_t max[3] = {6, 5, 4};
+        bool filled = true;
+        bool cleared = true;
+
+        check(world.fillBox(min, max, 9), "fillBox succeeds");
+
+        for (std::int32_t z = min[2] - 1; z <= max[2] + 1; z++) {
+            for (std::int32_t y = min[1] - 1; y <= max[1] + 1; y++) {
+                for (std::int32_t x = min[0] - 1; x <= max[0] + 1; x++) {
+                    bool inside = x >= min[0] && x <= max[0] && y >= min[1] && y <= max[1] && z >= min[2] && z <= max[2];
+                    filled = filled && (inside ? hasVoxel(world, x, y, z, 9) : x == -1 && y == -1 && z == -1 ? true : isEmpty(world, x, y, z));
+                }
+            }
+        }
+
+        check(filled, "fillBox fills exactly cells of inclusive box");
+        check(world.clearBox(min, max), "clearBox succeeds");
+
+        for (std::int32_t z = min[2]; z <= max[2]; z++) {
+            for (std::int32_t y = min[1]; y <= max[1]; y++) {
+                for (std::int32_t x = min[0]; x <= max[0]; x++) {
+                    cleared = cleared && isEmpty(world, x, y, z);
+                }
+            }
+        }
+
+        check(cleared, "clearBox clears every cell of box");
+        check(hasVoxel(world, CHUNK_SIZE, 0, -CHUNK_SIZE - 1, 0), "clearBox keeps cells out of box");
+
+        const std::int32_t reversedMin[3] = {5, 0, 0};
+        const std::int32_t reversedMax[3] = {4, 0, 0};
+        check(world.fillBox(reversedMin, reversedMax, 1) && isEmpty(world, 4, 0, 0) && isEmpty(world, 5, 0, 0), "box with min above max is empty");
+        check(scene.platform->getErrorCount() == 0, "edits inside world report no errors");
+    }
+
+    void testDirtyChunks() {
+        Scene scene;
+        voxel::VoxelWorld &world = *scene.world;
+        const std::int32_t min[3] = {0, 0, 0};
+        const std::int32_t max[3] = {CHUNK_SIZE * 2 - 1, CHUNK_SIZE - 1, CHUNK_SIZE - 1};
+
+        // every dirty chunk is rebuilt by the next frame
+        world.setRebuildBudget(1000.0f);
+        world.fillBox(min, max, 3);
+        check(world.getStatistics().dirtyChunks == 2, "filled chunks are dirty");
+
+        scene.drawFrame();
+        voxel::VoxelWorld::Statistics statistics = world.getStatistics();
+        check(statistics.chunksRebuilt == 2 && statistics.dirtyChunks == 0, "dirty chunks are rebuilt");
+        check(statistics.chunksDrawn == 2 && statistics.instancesSubmitted == 2, "full chunks are merged into one box each");
+        check(statistics.gpuBytes == 2 * sizeof(voxel::Voxel), "GPU buffers have one box per chunk");
+
+        world.setVoxel(1, 1, 1, 3);
+        world.fillBox(min, max, 3);
+        check(world.getStatistics().dirtyChunks == 0, "writing the same colors marks nothing");
+
+        world.setVoxel(CHUNK_SIZE, 0, 0, 4);
+        world.setVoxel(CHUNK_SIZE + 1, 0, 0, 4);
+        check(world.getStatistics().dirtyChunks == 1, "chunk is marked once for several changes");
+
+        scene.drawFrame();
+        check(world.getStatistics().instancesSubmitted > 2, "changed chunk is rebuilt with more boxes");
+
+        const std::int32_t firstMin[3] = {0, 0, 0};
+        const std::int32_t firstMax[3] = {CHUNK_SIZE - 1, CHUNK_SIZE - 1, CHUNK_SIZE - 1};
+        world.clearBox(firstMin, firstMax);
+        check(world.getStatistics().chunks == 2 && world.getStatistics().dirtyChunks == 1, "emptied chunk stays until rebuild");
+
+        scene.drawFrame();
+        check(world.getStatistics().chunks == 1 && world.getStatistics().chunksDrawn == 1, "rebuild removes emptied chunk");
+    }
+
+    void testRebuildBudget() {
+        Scene scene;
+        voxel::VoxelWorld &world = *scene.world;
+
+        // the nearest chunk is the only one in draw distance, so it's drawn after the first rebuild only if it's taken first
+        world.setVoxel(0, 0, CHUNK_SIZE * 4, 1);
+        world.setVoxel(0, 0, -CHUNK_SIZE * 8, 1);
+        world.setVoxel(0, 0, -CHUNK_SIZE * 16, 1);
+        world.setDrawDistance(100.0f);
+        world.setRebuildBudget(0.0f);
+
+        scene.drawFrame();
+        check(world.getStatistics().chunksRebuilt == 1 && world.getStatistics().dirtyChunks == 2, "zero budget rebuilds one chunk per frame");
+        check(world.getStatistics().chunksDrawn == 1, "the nearest chunk is rebuilt first");
+        scene.drawFrame();
+        scene.drawFrame();
+        check(world.getStatistics().chunksRebuilt == 1 && world.getStatistics().dirtyChunks == 0, "every dirty chunk is rebuilt in its frame");
+
+        // chunks of alternating colors, so merging takes measurable time
+        const std::int32_t side = CHUNK_SIZE * 6;
+        float chunkMs = 0.0f;
+
+        world.setDrawDistance(10000.0f);
+
+        for (std::int32_t z = 0; z < CHUNK_SIZE; z++) {
+            for (std::int32_t y = 0; y < side; y++) {
+                for (std::int32_t x = 0; x < side; x++) {
+                    world.setVoxel(x - side / 2, y - side / 2, z - CHUNK_SIZE, std::uint8_t((x + y + z) % 2));
+                }
+            }
+        }
+
+        std::uint32_t chunkCount = world.getStatistics().dirtyChunks;
+
+        for (std::uint32_t i = 0; i < chunkCount; i++) {
+            scene.drawFrame();
+            chunkMs = std::max(chunkMs, world.getStatistics().rebuildTimeMs);
+        }
+
+        check(world.getStatistics().dirtyChunks == 0, "every chunk is rebuilt one by one");
+
+        // the same chunks dirty again with budget of about a third of them
+        const std::int32_t min[3] = {-side / 2, -side / 2, -CHUNK_SIZE};
+        const std::int32_t max[3] = {side / 2 - 1, side / 2 - 1, -1};
+        float budgetMs = chunkMs * float(chunkCount) / 3.0f;
+        bool withinBudget = true;
+        std::size_t frames = 0;
+
+        world.fillBox(min, max, 7);
+        world.clearBox(min, max);
+
+        for (std::int32_t z = 0; z < CHUNK_SIZE; z++) {
+            for (std::int32_t y = 0; y < side; y++) {
+                for (std::int32_t x = 0; x < side; x++) {
+                    world.setVoxel(x - side / 2, y - side / 2, z - CHUNK_SIZE, std::uint8_t((x + y + z) % 2 + 1));
+                }
+            }
+        }
+
+        world.setRebuildBudget(budgetMs);
+
+        while (world.getStatistics().dirtyChunks && frames < chunkCount) {
+            scene.drawFrame();
+            withinBudget = withinBudget && world.getStatistics().rebuildTimeMs <= budgetMs + chunkMs * 2.0f;
+            frames++;
+        }
+
+        check(world.getStatistics().dirtyChunks == 0, "budgeted rebuild finishes");
+        check(frames > 1, "budget spreads rebuild over several frames");
+        check(withinBudget, "rebuild overruns budget by one chunk at most");
+    }
+
+    void testWorldExtent() {
+        Scene scene;
+        voxel::VoxelWorld &world = *scene.world;
+
+        scene.platform->setMessagesMuted(true);
+        check(world.setVoxel(EXTENT - 1, -EXTENT, 0, 1), "setVoxel at the edges of world succeeds");
+        check(world.setVoxel(0, 0, 0, 2), "setVoxel at origin succeeds");
+        check(world.setVoxel(EXTENT, 0, 0, 3) == false, "setVoxel beyond positive extent is rejected");
+        check(world.setVoxel(0, 0, -EXTENT - 1, 3) == false, "setVoxel beyond negative extent is rejected");
+        check(world.clearVoxel(EXTENT * 2, 0, 0) == false, "clearVoxel beyond extent is rejected");
+        check(hasVoxel(world, 0, 0, 0, 2), "rejected edits don't alias cell at origin");
+        check(hasVoxel(world, EXTENT - 1, -EXTENT, 0, 1), "cell at the edges keeps its color");
+        check(isEmpty(world, EXTENT, 0, 0), "cell beyond extent is empty");
+
+        const std::int32_t min[3] = {EXTENT - 4, 0, 0};
+        const std::int32_t max[3] = {EXTENT + 4, 0, 0};
+        const std::int32_t wrappedMin[3] = {-EXTENT - 4, 0, 0};
+        const std::int32_t wrappedMax[3] = {-EXTENT, 0, 0};
+        check(world.fillBox(min, max, 4) == false, "fillBox crossing extent is rejected");
+        check(world.clearBox(wrappedMin, wrappedMax) == false, "clearBox crossing extent is rejected");
+        check(isEmpty(world, EXTENT - 4, 0, 0), "rejected box changes nothing");
+        check(scene.platform->getErrorCount() == 5, "every rejected edit is reported");
+    }
+
+    void testDrawing() {
+        Scene scene;
+        voxel::VoxelWorld &world = *scene.world;
+        std::vector<std::uint8_t> red (256 * 4, 0);
+
+        for (std::size_t i = 0; i < red.size(); i += 4) {
+            red[i] = red[i + 3] = 0xff;
+        }
+
+        scene.platform->setMessagesMuted(true);
+        scene.renderingDevice->setKeepData(true);
+
+        std::shared_ptr<voxel::VoxelMesh> mesh = scene.meshes->loadMesh("data/knight");
+        std::uint32_t row = scene.meshes->addPalette(red.data());
+        world.setVoxel(0, 0, 0, 1);
+        check(mesh != nullptr, "knight is loaded");
+
+        // constants of chunk draw are read while they are kept by meshes
+        auto getChunkTexcoord = [&]() {
+            scene.drawFrame();
+            const std::vector<HeadlessRenderingDevice::Draw> &draws = scene.renderingDevice->getFrameDraws();
+            return draws.size() ? static_cast<const math::transform3f *>(draws.back().constants)->flat16[15] : -1.0f;
+        };
+
+        float defaultTexcoord = getChunkTexcoord();
+        const std::vector<HeadlessRenderingDevice::Draw> &draws = scene.renderingDevice->getFrameDraws();
+        bool sameShader = draws.size() >= 2;
+
+        for (const HeadlessRenderingDevice::Draw &draw : draws) {
+            sameShader = sameShader && draw.shader == draws[0].shader;
+        }
+
+        check(world.getStatistics().chunksDrawn == 1 && scene.meshes->getStatistics().meshesDrawn == 1, "chunk and mesh are drawn");
+        check(sameShader, "chunk is drawn with shader of meshes");
+        check(draws.size() && draws.back().instanceCount == 1, "chunk draw has its one box");
+
+        world.setPalette(row);
+        float rowTexcoord = getChunkTexcoord();
+        check(defaultTexcoord >= 0.0f && rowTexcoord >= 0.0f && rowTexcoord != defaultTexcoord, "chunk takes palette row of atlas");
+        check(scene.renderingDevice->getTotalCounters().texturesCreated <= 2, "chunks have no palette texture of their own");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    testEdits();
+    testDirtyChunks();
+    testRebuildBudget();
+    testWorldExtent();
+    testDrawing();
+
+    printf("%s: %d failed checks\n", argc ? argv[0] : "voxel_world_test", failures);
+    return failures;
+}